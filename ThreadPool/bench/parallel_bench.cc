@@ -0,0 +1,125 @@
+/*
+	Parallel algorithms benchmark: scaling sweep.
+
+	For every schedule and pool size (1 .. hardware
+	concurrency, doubling) we time
+		reduce     parallel_reduce summing `--n` doubles
+		transform  parallel_transform y[i] = sqrt(x[i])
+	and report the best of `--reps` runs. speedup is
+	relative to the 1-thread run of the same schedule
+	and algorithm. Output is CSV:
+
+		algorithm,schedule,threads,ms,speedup
+
+	The default n is 10^8 (800 MB per array); pass a
+	smaller --n on machines without that much memory.
+
+	Build:
+		g++ -std=c++17 -O2 -pthread -I../include -I../../ThreadSafeQueue/include parallel_bench.cc -o parallel_bench
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ParallelAlgorithms.hpp"
+
+namespace {
+
+struct options
+{
+	std::size_t n = 100000000;
+	unsigned reps = 3;
+	unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+};
+
+template<typename Run>
+double best_ms(unsigned reps, Run run)
+{
+	double best = 0;
+	for (unsigned r = 0; r < reps; ++r) {
+		auto const start = std::chrono::steady_clock::now();
+		run();
+		double const ms = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+		if (r == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+void sweep(char const* schedule_name, chunking schedule, options const& opt,
+		std::vector<double> const& x, std::vector<double>& y)
+{
+	parallel_options popts;
+	popts.schedule = schedule;
+	double reduce_base = 0;
+	double transform_base = 0;
+	for (unsigned t = 1; t <= opt.max_threads; t *= 2) {
+		thread_pool pool(t);
+		volatile double sink = 0;
+		double const reduce_ms = best_ms(opt.reps, [&]{
+			sink = parallel_reduce(pool, x.begin(), x.end(), 0.0,
+				[](double a, double b) { return a + b; }, popts);
+		});
+		double const transform_ms = best_ms(opt.reps, [&]{
+			parallel_transform(pool, x.begin(), x.end(), y.begin(),
+				[](double v) { return std::sqrt(v); }, popts);
+		});
+		if (t == 1) {
+			reduce_base = reduce_ms;
+			transform_base = transform_ms;
+		}
+		std::cout << "reduce," << schedule_name << ',' << t << ',' << reduce_ms << ','
+			<< reduce_base / reduce_ms << '\n';
+		std::cout << "transform," << schedule_name << ',' << t << ',' << transform_ms << ','
+			<< transform_base / transform_ms << '\n';
+	}
+}
+
+bool parse_args(int argc, char** argv, options& opt)
+{
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string const arg = argv[i];
+		std::string const value = argv[i + 1];
+		if (arg == "--n")
+			opt.n = std::strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--reps")
+			opt.reps = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else if (arg == "--max-threads")
+			opt.max_threads = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+	}
+	if (argc % 2 == 0) {
+		std::cerr << "missing value for " << argv[argc - 1] << "\n";
+		return false;
+	}
+	return opt.n > 0 && opt.reps > 0 && opt.max_threads > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	options opt;
+	if (!parse_args(argc, argv, opt))
+		return 1;
+
+	std::vector<double> x(opt.n);
+	for (std::size_t i = 0; i < x.size(); ++i)
+		x[i] = static_cast<double>(i % 1000);
+	std::vector<double> y(opt.n);
+
+	std::cout << "algorithm,schedule,threads,ms,speedup\n";
+	sweep("static", chunking::static_blocks, opt, x, y);
+	sweep("dynamic", chunking::dynamic, opt, x, y);
+	sweep("guided", chunking::guided, opt, x, y);
+	return 0;
+}
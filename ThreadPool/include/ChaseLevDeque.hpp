@@ -0,0 +1,138 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+	Chase–Lev work-stealing deque (the C11 formulation by
+	Lê, Pop, Cohen and Zappa Nardelli).
+
+	One owner thread pushes and pops at the bottom (LIFO,
+	so it keeps working on the freshest, cache-hot task).
+	Any number of thieves steal from the top (FIFO, so
+	they take the oldest and usually largest piece of
+	work). The owner only synchronises with thieves when
+	the deque is down to its last element.
+
+	Elements are read by thieves before they win the CAS
+	on `top`, so T must be trivially copyable; the pool
+	stores task pointers.
+
+	The ring grows when full. Old rings are kept until
+	the deque is destroyed because a slow thief may still
+	be reading from one.
+*/
+template<typename T>
+class ChaseLevDeque
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+			"ChaseLevDeque elements must be trivially copyable");
+
+	private:
+		static constexpr std::size_t cache_line = 64;
+
+		struct ring
+		{
+			std::int64_t const capacity;
+			std::unique_ptr<std::atomic<T>[]> slots;
+
+			explicit ring(std::int64_t cap) : capacity(cap), slots(new std::atomic<T>[cap]) {}
+
+			T get(std::int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+			void put(std::int64_t i, T x) { slots[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+		};
+
+		alignas(cache_line) std::atomic<std::int64_t> top;
+		alignas(cache_line) std::atomic<std::int64_t> bottom;
+		std::atomic<ring*> active;
+		std::vector<std::unique_ptr<ring>> rings;	// owner only
+
+		ring* grow(ring* old, std::int64_t b, std::int64_t t)
+		{
+			rings.emplace_back(new ring(old->capacity * 2));
+			ring* const bigger = rings.back().get();
+			for (std::int64_t i = t; i < b; ++i)
+				bigger->put(i, old->get(i));
+			active.store(bigger, std::memory_order_release);
+			return bigger;
+		}
+
+	public:
+		explicit ChaseLevDeque(std::int64_t capacity = 256) : top(0), bottom(0)
+		{
+			std::int64_t cap = 2;
+			while (cap < capacity)
+				cap <<= 1;
+			rings.emplace_back(new ring(cap));
+			active.store(rings.back().get(), std::memory_order_relaxed);
+		}
+
+		ChaseLevDeque(ChaseLevDeque const&) = delete;
+		ChaseLevDeque& operator=(ChaseLevDeque const&) = delete;
+
+		// Owner only.
+		void push(T x)
+		{
+			std::int64_t const b = bottom.load(std::memory_order_relaxed);
+			std::int64_t const t = top.load(std::memory_order_acquire);
+			ring* a = active.load(std::memory_order_relaxed);
+			if (b - t > a->capacity - 1)
+				a = grow(a, b, t);
+			a->put(b, x);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		// Owner only.
+		bool pop(T& out)
+		{
+			std::int64_t const b = bottom.load(std::memory_order_relaxed) - 1;
+			ring* const a = active.load(std::memory_order_relaxed);
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t t = top.load(std::memory_order_relaxed);
+			if (t > b) {
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return false;
+			}
+			out = a->get(b);
+			if (t == b) {
+				// Last element: race the thieves for it.
+				bool const won = top.compare_exchange_strong(t, t + 1,
+						std::memory_order_seq_cst, std::memory_order_relaxed);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return won;
+			}
+			return true;
+		}
+
+		// Any thread. May fail spuriously under contention.
+		bool steal(T& out)
+		{
+			std::int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t const b = bottom.load(std::memory_order_acquire);
+			if (t >= b)
+				return false;
+			ring* const a = active.load(std::memory_order_acquire);
+			T x = a->get(t);
+			if (!top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+				return false;
+			out = x;
+			return true;
+		}
+
+		// Approximate; may be stale by the time it returns.
+		std::int64_t size() const
+		{
+			std::int64_t const b = bottom.load(std::memory_order_relaxed);
+			std::int64_t const t = top.load(std::memory_order_relaxed);
+			return b > t ? b - t : 0;
+		}
+
+		bool empty() const { return size() == 0; }
+};
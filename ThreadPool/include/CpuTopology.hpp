@@ -0,0 +1,183 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <filesystem>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+	CPU / NUMA topology as seen by the pool.
+
+	On Linux it is read from sysfs: the online CPUs come
+	from /sys/devices/system/cpu/online and each
+	/sys/devices/system/cpu/cpuN directory contains a
+	`nodeK` link naming its NUMA node. Only CPUs in the
+	process's affinity mask (sched_getaffinity, which
+	reflects taskset and cgroup cpusets) are kept, so
+	nothing is ever pinned to a CPU we may not use. Node
+	ids are compacted to 0 .. node_count-1 in OS order,
+	so sparse ids or nodes with no usable CPU don't show
+	up as empty nodes; node_ids maps back. Anywhere else
+	(or if sysfs is unreadable) we fall back to one node
+	with the allowed CPUs, or hardware_concurrency() of
+	them.
+*/
+struct cpu_topology
+{
+	struct cpu
+	{
+		unsigned id;
+		unsigned node;		// compact index
+	};
+
+	std::vector<cpu> cpus;		// sorted by node, then id
+	unsigned node_count = 1;
+	std::vector<unsigned> node_ids;	// OS id of each node
+	std::vector<int> node_of_cpu;	// by CPU id; -1 if not usable
+
+	// Parses the kernel's cpulist format, e.g. "0-3,8,10-11".
+	static std::vector<unsigned> parse_cpu_list(std::string const& list)
+	{
+		std::vector<unsigned> ids;
+		std::size_t pos = 0;
+		while (pos < list.size()) {
+			std::size_t const end = std::min(list.find(',', pos), list.size());
+			std::string const part = list.substr(pos, end - pos);
+			std::size_t const dash = part.find('-');
+			try {
+				unsigned const first = static_cast<unsigned>(std::stoul(part.substr(0, dash)));
+				unsigned const last = dash == std::string::npos
+					? first : static_cast<unsigned>(std::stoul(part.substr(dash + 1)));
+				for (unsigned id = first; id <= last; ++id)
+					ids.push_back(id);
+			} catch (...) {
+				// Ignore malformed fragments (e.g. a trailing newline).
+			}
+			pos = end + 1;
+		}
+		return ids;
+	}
+
+	// CPUs this process may run on, ascending; empty if unknown.
+	static std::vector<unsigned> allowed_cpus()
+	{
+		std::vector<unsigned> ids;
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			for (unsigned id = 0; id < CPU_SETSIZE; ++id) {
+				if (CPU_ISSET(id, &set))
+					ids.push_back(id);
+			}
+		}
+#endif
+		return ids;
+	}
+
+	static cpu_topology detect()
+	{
+		cpu_topology topo;
+		std::vector<unsigned> const allowed = allowed_cpus();
+		// cpu.node holds the OS node id until we compact below.
+#ifdef __linux__
+		namespace fs = std::filesystem;
+		std::ifstream online("/sys/devices/system/cpu/online");
+		std::string list;
+		if (online && std::getline(online, list)) {
+			for (unsigned id : parse_cpu_list(list)) {
+				if (!allowed.empty() && !std::binary_search(allowed.begin(), allowed.end(), id))
+					continue;
+				unsigned node = 0;
+				std::error_code ec;
+				fs::path const dir = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+				for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+					std::string const name = it->path().filename().string();
+					if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+							name.find_first_not_of("0123456789", 4) == std::string::npos) {
+						node = static_cast<unsigned>(std::stoul(name.substr(4)));
+						break;
+					}
+				}
+				topo.cpus.push_back(cpu{id, node});
+			}
+		}
+#endif
+		if (topo.cpus.empty()) {
+			for (unsigned id : allowed)
+				topo.cpus.push_back(cpu{id, 0});
+		}
+		if (topo.cpus.empty()) {
+			unsigned const n = std::max(1u, std::thread::hardware_concurrency());
+			for (unsigned id = 0; id < n; ++id)
+				topo.cpus.push_back(cpu{id, 0});
+		}
+
+		for (cpu const& c : topo.cpus)
+			topo.node_ids.push_back(c.node);
+		std::sort(topo.node_ids.begin(), topo.node_ids.end());
+		topo.node_ids.erase(std::unique(topo.node_ids.begin(), topo.node_ids.end()), topo.node_ids.end());
+		topo.node_count = static_cast<unsigned>(topo.node_ids.size());
+		unsigned max_id = 0;
+		for (cpu& c : topo.cpus) {
+			c.node = static_cast<unsigned>(std::lower_bound(topo.node_ids.begin(),
+				topo.node_ids.end(), c.node) - topo.node_ids.begin());
+			max_id = std::max(max_id, c.id);
+		}
+		std::sort(topo.cpus.begin(), topo.cpus.end(),
+			[](cpu const& a, cpu const& b) { return a.node != b.node ? a.node < b.node : a.id < b.id; });
+		topo.node_of_cpu.assign(max_id + 1, -1);
+		for (cpu const& c : topo.cpus)
+			topo.node_of_cpu[c.id] = static_cast<int>(c.node);
+		return topo;
+	}
+
+	// NUMA node of the CPU the caller is running on (0 if unknown).
+	unsigned current_node() const
+	{
+#ifdef __linux__
+		int const id = sched_getcpu();
+		if (id >= 0 && static_cast<std::size_t>(id) < node_of_cpu.size() && node_of_cpu[id] >= 0)
+			return static_cast<unsigned>(node_of_cpu[id]);
+#endif
+		return 0;
+	}
+
+	// Usable CPUs on `node`.
+	std::vector<unsigned> node_cpus(unsigned node) const
+	{
+		std::vector<unsigned> ids;
+		for (cpu const& c : cpus) {
+			if (c.node == node)
+				ids.push_back(c.id);
+		}
+		return ids;
+	}
+
+	// Restrict the calling thread to `cpu_ids`. Returns
+	// false if unsupported or refused.
+	static bool bind_current_thread(std::vector<unsigned> const& cpu_ids)
+	{
+#ifdef __linux__
+		if (cpu_ids.empty())
+			return false;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (unsigned id : cpu_ids) {
+			if (id < CPU_SETSIZE)
+				CPU_SET(id, &set);
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)cpu_ids;
+		return false;
+#endif
+	}
+};
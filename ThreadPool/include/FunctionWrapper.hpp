@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+	Move-only, type-erased `void()` callable.
+
+	std::function<void()> insists on copyable targets,
+	which forces std::packaged_task into a shared_ptr,
+	and it heap-allocates for anything bigger than a
+	couple of pointers. function_wrapper only needs the
+	target to be movable and keeps it in a 48-byte inline
+	buffer; together with the vtable pointer the whole
+	wrapper fits in one 64-byte cache line.
+
+	Callables that are too large, over-aligned or whose
+	move constructor may throw fall back to the heap.
+*/
+class function_wrapper
+{
+	public:
+		static constexpr std::size_t buffer_size = 48;
+
+	private:
+		struct vtable
+		{
+			void (*call)(void* self);
+			void (*move_to)(void* dst, void* src) noexcept;
+			void (*destroy)(void* self) noexcept;
+		};
+
+		template<typename F>
+		static constexpr bool fits_inline =
+			sizeof(F) <= buffer_size &&
+			alignof(F) <= alignof(std::max_align_t) &&
+			std::is_nothrow_move_constructible<F>::value;
+
+		template<typename F>
+		struct inline_impl
+		{
+			static F* get(void* self) { return std::launder(static_cast<F*>(self)); }
+			static void call(void* self) { (*get(self))(); }
+			static void move_to(void* dst, void* src) noexcept
+			{
+				::new (dst) F(std::move(*get(src)));
+				get(src)->~F();
+			}
+			static void destroy(void* self) noexcept { get(self)->~F(); }
+			static constexpr vtable table{&call, &move_to, &destroy};
+		};
+
+		template<typename F>
+		struct heap_impl
+		{
+			static F*& get(void* self) { return *std::launder(static_cast<F**>(self)); }
+			static void call(void* self) { (*get(self))(); }
+			static void move_to(void* dst, void* src) noexcept
+			{
+				::new (dst) F*(get(src));
+			}
+			static void destroy(void* self) noexcept { delete get(self); }
+			static constexpr vtable table{&call, &move_to, &destroy};
+		};
+
+		alignas(std::max_align_t) unsigned char buffer[buffer_size];
+		vtable const* impl;
+
+		void reset() noexcept
+		{
+			if (impl) {
+				impl->destroy(buffer);
+				impl = nullptr;
+			}
+		}
+
+	public:
+		function_wrapper() noexcept : impl(nullptr) {}
+
+		template<typename F,
+			typename = std::enable_if_t<!std::is_same<std::decay_t<F>, function_wrapper>::value>>
+		function_wrapper(F&& f) : impl(nullptr)
+		{
+			using callable = std::decay_t<F>;
+			if constexpr (fits_inline<callable>) {
+				::new (static_cast<void*>(buffer)) callable(std::forward<F>(f));
+				impl = &inline_impl<callable>::table;
+			} else {
+				::new (static_cast<void*>(buffer)) callable*(new callable(std::forward<F>(f)));
+				impl = &heap_impl<callable>::table;
+			}
+		}
+
+		function_wrapper(function_wrapper&& other) noexcept : impl(other.impl)
+		{
+			if (impl) {
+				impl->move_to(buffer, other.buffer);
+				other.impl = nullptr;
+			}
+		}
+
+		function_wrapper& operator=(function_wrapper&& other) noexcept
+		{
+			if (this != &other) {
+				reset();
+				if (other.impl) {
+					other.impl->move_to(buffer, other.buffer);
+					impl = other.impl;
+					other.impl = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		function_wrapper(function_wrapper const&) = delete;
+		function_wrapper& operator=(function_wrapper const&) = delete;
+
+		~function_wrapper()
+		{
+			reset();
+		}
+
+		void operator()()
+		{
+			impl->call(buffer);
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return impl != nullptr;
+		}
+};
@@ -0,0 +1,204 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+/*
+	when_all / when_any / when_some for pool_future.
+
+	Collecting results by calling get() on each future
+	in turn (synching_tasks.cpp) holds up the fast ones
+	behind a slow early one and parks the collecting
+	thread. These combinators instead attach a small
+	continuation to every input (pool_future::relay)
+	that bumps an atomic counter in one shared block;
+	the input that completes the count publishes the
+	combined future. No thread waits for any of it.
+
+		when_all(f1, f2, ...)   future<tuple<future...>>
+		when_all(first, last)   future<vector<future>>
+		when_any(first, last)   future<when_any_result>
+		when_some(first, last, n)
+		                        future<when_some_result>
+
+	As in the Concurrency TS the result hands the input
+	futures back, ready, in a sequence sized up front,
+	so per-input errors surface through each one's get().
+	when_any / when_some also say which inputs finished
+	first (in completion order). The rest may still be
+	running; drop them to ignore the stragglers, or wait
+	on / then() them like any other future.
+
+	The range overloads take forward iterators over
+	pool_futures and move from them.
+*/
+template<typename Sequence>
+struct when_any_result
+{
+	std::size_t index;	// size_t(-1) for an empty input
+	Sequence futures;
+};
+
+template<typename Sequence>
+struct when_some_result
+{
+	std::vector<std::size_t> indices;
+	Sequence futures;
+};
+
+template<typename T>
+struct is_pool_future : std::false_type {};
+
+template<typename T>
+struct is_pool_future<pool_future<T>> : std::true_type {};
+
+/*
+	`remaining` starts one above the number of inputs and
+	the caller drops the extra count once every input is
+	wired up, so inputs that are already ready can't
+	publish the result while the sequence is still being
+	filled in.
+*/
+template<typename Sequence>
+class when_all_state
+{
+	private:
+		std::atomic<std::size_t> remaining;
+		pool_promise<Sequence> promise;
+
+	public:
+		Sequence futures;
+
+		when_all_state(std::size_t inputs, thread_pool* pool)
+			: remaining(inputs + 1), promise(pool)
+		{}
+
+		pool_future<Sequence> get_future()
+		{
+			return promise.get_future();
+		}
+
+		void arrive()
+		{
+			if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				promise.set_value(std::move(futures));
+		}
+};
+
+/*
+	The first `needed` inputs to arrive claim a slot in
+	`indices`; a second counter tracks the finished
+	writes, so whoever completes it sees every index.
+	As above, the caller holds one extra count until
+	setup is done. Later arrivals only touch `arrived`.
+*/
+template<typename Sequence>
+class when_some_state
+{
+	private:
+		std::size_t const needed;
+		std::atomic<std::size_t> arrived{0};
+		std::atomic<std::size_t> recorded{0};
+		std::vector<std::size_t> indices;
+		pool_promise<when_some_result<Sequence>> promise;
+
+	public:
+		Sequence futures;
+
+		when_some_state(std::size_t needed_, thread_pool* pool)
+			: needed(needed_), indices(needed_), promise(pool)
+		{}
+
+		pool_future<when_some_result<Sequence>> get_future()
+		{
+			return promise.get_future();
+		}
+
+		void arrive(std::size_t index)
+		{
+			std::size_t const k = arrived.fetch_add(1, std::memory_order_relaxed);
+			if (k >= needed)
+				return;
+			indices[k] = index;
+			record();
+		}
+
+		void record()
+		{
+			if (recorded.fetch_add(1, std::memory_order_acq_rel) == needed)
+				promise.set_value(when_some_result<Sequence>{std::move(indices), std::move(futures)});
+		}
+};
+
+template<typename Shared, std::size_t... I, typename... Futures>
+void when_all_wire(std::shared_ptr<Shared> const& shared, std::index_sequence<I...>, Futures&... futures)
+{
+	((std::get<I>(shared->futures) = futures.relay([shared]{ shared->arrive(); })), ...);
+}
+
+template<typename... Ts>
+auto when_all(pool_future<Ts>... futures) -> pool_future<std::tuple<pool_future<Ts>...>>
+{
+	using sequence = std::tuple<pool_future<Ts>...>;
+	thread_pool* pool = nullptr;
+	((pool = pool ? pool : futures.pool()), ...);
+	auto shared = std::make_shared<when_all_state<sequence>>(sizeof...(Ts), pool);
+	pool_future<sequence> res = shared->get_future();
+	when_all_wire(shared, std::index_sequence_for<Ts...>(), futures...);
+	shared->arrive();
+	return res;
+}
+
+template<typename ForwardIt,
+	typename = std::enable_if_t<!is_pool_future<std::decay_t<ForwardIt>>::value>>
+auto when_all(ForwardIt first, ForwardIt last)
+	-> pool_future<std::vector<typename std::iterator_traits<ForwardIt>::value_type>>
+{
+	using sequence = std::vector<typename std::iterator_traits<ForwardIt>::value_type>;
+	std::size_t const n = static_cast<std::size_t>(std::distance(first, last));
+	auto shared = std::make_shared<when_all_state<sequence>>(n, n ? first->pool() : nullptr);
+	shared->futures.resize(n);
+	pool_future<sequence> res = shared->get_future();
+	for (std::size_t i = 0; first != last; ++first, ++i)
+		shared->futures[i] = first->relay([shared]{ shared->arrive(); });
+	shared->arrive();
+	return res;
+}
+
+// Ready once the first `n` inputs (all of them, if
+// there are fewer) are.
+template<typename ForwardIt>
+auto when_some(ForwardIt first, ForwardIt last, std::size_t n)
+	-> pool_future<when_some_result<std::vector<typename std::iterator_traits<ForwardIt>::value_type>>>
+{
+	using sequence = std::vector<typename std::iterator_traits<ForwardIt>::value_type>;
+	std::size_t const inputs = static_cast<std::size_t>(std::distance(first, last));
+	auto shared = std::make_shared<when_some_state<sequence>>(
+		n < inputs ? n : inputs, inputs ? first->pool() : nullptr);
+	shared->futures.resize(inputs);
+	auto res = shared->get_future();
+	for (std::size_t i = 0; first != last; ++first, ++i)
+		shared->futures[i] = first->relay([shared, i]{ shared->arrive(i); });
+	shared->record();
+	return res;
+}
+
+template<typename ForwardIt>
+auto when_any(ForwardIt first, ForwardIt last)
+	-> pool_future<when_any_result<std::vector<typename std::iterator_traits<ForwardIt>::value_type>>>
+{
+	using sequence = std::vector<typename std::iterator_traits<ForwardIt>::value_type>;
+	return when_some(first, last, 1).then(then_policy::run_inline,
+		[](pool_future<when_some_result<sequence>> ready) {
+			when_some_result<sequence> r = ready.get();
+			std::size_t const index = r.indices.empty() ? static_cast<std::size_t>(-1) : r.indices[0];
+			return when_any_result<sequence>{index, std::move(r.futures)};
+		});
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+/*
+	Data-parallel loops on top of thread_pool.
+
+	A range [first, last) is split into chunks that a
+	handful of "runners" work through; the calling
+	thread is runner 0 and the others are pool tasks.
+	Running a chunk is a plain loop, so the per-element
+	cost is what it would be single-threaded and the
+	pool is only touched once per runner.
+
+	How the chunks are handed out:
+		static_blocks  one contiguous block per runner,
+		               decided up front. Cheapest, and
+		               the right thing when every
+		               iteration costs the same.
+		dynamic        runners take `grain` elements at
+		               a time from a shared counter until
+		               it runs out.
+		guided         like dynamic, but each claim takes
+		               remaining / (2 * runners) elements,
+		               never fewer than `grain`: big
+		               chunks early, small ones at the
+		               end to even out the finish.
+
+	grain = 0 picks one from the range size and the pool
+	size (about 8 chunks per runner for dynamic, a floor
+	4x smaller than that for guided).
+
+	Callable from inside a pool task as well: the wait
+	for the helper runners goes through pool_future, so
+	a worker keeps running queued tasks meanwhile.
+*/
+enum class chunking
+{
+	static_blocks,
+	dynamic,
+	guided
+};
+
+struct parallel_options
+{
+	chunking schedule = chunking::guided;
+	std::size_t grain = 0;
+};
+
+struct chunk_plan
+{
+	std::size_t grain;
+	unsigned runners;
+
+	static chunk_plan make(thread_pool const& pool, std::size_t n, parallel_options const& opts)
+	{
+		std::size_t const workers = std::max<unsigned>(pool.size(), 1);
+		std::size_t grain = opts.grain;
+		if (grain == 0) {
+			std::size_t const per_runner = opts.schedule == chunking::guided ? 32 : 8;
+			grain = std::max<std::size_t>(n / (workers * per_runner), 1);
+		}
+		std::size_t const chunks = opts.schedule == chunking::static_blocks ? n : (n + grain - 1) / grain;
+		return chunk_plan{grain, static_cast<unsigned>(std::max<std::size_t>(std::min(workers, chunks), 1))};
+	}
+};
+
+// Shared cursor for the dynamic and guided schedules.
+class chunk_dispenser
+{
+	private:
+		std::atomic<std::size_t> next;
+		std::size_t const last;
+		std::size_t const grain;
+		std::size_t const runners;
+		bool const guided;
+
+	public:
+		chunk_dispenser(std::size_t first, std::size_t last_, chunk_plan const& plan, chunking mode)
+			: next(first), last(last_), grain(plan.grain), runners(plan.runners),
+			  guided(mode == chunking::guided)
+		{}
+
+		bool claim(std::size_t& begin, std::size_t& end)
+		{
+			std::size_t cur = next.load(std::memory_order_relaxed);
+			for (;;) {
+				if (cur >= last)
+					return false;
+				std::size_t const remaining = last - cur;
+				std::size_t take = guided ? std::max(grain, remaining / (2 * runners)) : grain;
+				take = std::min(take, remaining);
+				if (next.compare_exchange_weak(cur, cur + take, std::memory_order_relaxed)) {
+					begin = cur;
+					end = cur + take;
+					return true;
+				}
+			}
+		}
+};
+
+/*
+	Runs body(runner, begin, end) over [first, last)
+	according to `plan`; the building block for the
+	algorithms below. Every helper is waited for before
+	returning, even when one of them throws, since they
+	all reference our stack; the first exception is
+	rethrown.
+*/
+template<typename Body>
+void run_chunked(thread_pool& pool, std::size_t first, std::size_t last,
+		chunk_plan const& plan, chunking mode, Body& body)
+{
+	if (first >= last)
+		return;
+	std::size_t const n = last - first;
+	chunk_dispenser chunks(first, last, plan, mode);
+	auto const run = [&](unsigned runner) {
+		if (mode == chunking::static_blocks) {
+			std::size_t const q = n / plan.runners;
+			std::size_t const rem = n % plan.runners;
+			std::size_t const begin = first + runner * q + std::min<std::size_t>(runner, rem);
+			body(runner, begin, begin + q + (runner < rem ? 1 : 0));
+			return;
+		}
+		std::size_t begin, end;
+		while (chunks.claim(begin, end))
+			body(runner, begin, end);
+	};
+
+	std::vector<pool_future<void>> helpers;
+	helpers.reserve(plan.runners - 1);
+	std::exception_ptr error;
+	try {
+		for (unsigned r = 1; r < plan.runners; ++r)
+			helpers.push_back(pool.submit(run, r));
+		run(0);
+	} catch (...) {
+		error = std::current_exception();
+	}
+	for (pool_future<void>& h : helpers) {
+		try {
+			h.get();
+		} catch (...) {
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+// f(i) for every i in [first, last).
+template<typename Index, typename F>
+void parallel_for(thread_pool& pool, Index first, Index last, F f,
+		parallel_options const& opts = parallel_options())
+{
+	static_assert(std::is_integral<Index>::value, "parallel_for needs an integral index");
+	if (!(first < last))
+		return;
+	std::size_t const n = static_cast<std::size_t>(last - first);
+	chunk_plan const plan = chunk_plan::make(pool, n, opts);
+	auto body = [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			f(static_cast<Index>(first + static_cast<Index>(i)));
+	};
+	run_chunked(pool, 0, n, plan, opts.schedule, body);
+}
+
+// out[i] = f(first[i]); random-access iterators only.
+template<typename InputIt, typename OutputIt, typename F>
+OutputIt parallel_transform(thread_pool& pool, InputIt first, InputIt last, OutputIt out, F f,
+		parallel_options const& opts = parallel_options())
+{
+	std::size_t const n = static_cast<std::size_t>(last - first);
+	chunk_plan const plan = chunk_plan::make(pool, n, opts);
+	auto body = [&](unsigned, std::size_t begin, std::size_t end) {
+		for (std::size_t i = begin; i < end; ++i)
+			out[i] = f(first[i]);
+	};
+	run_chunked(pool, 0, n, plan, opts.schedule, body);
+	return out + n;
+}
+
+/*
+	Each runner folds its chunks into its own
+	accumulator (one cache line apiece, so runners never
+	write to a shared line), and the partials are folded
+	into `init` in runner order at the end. No identity
+	element is needed: an accumulator starts as the
+	first element of its first chunk.
+
+	With static_blocks the result is
+	init op x0 op x1 ... in order, so `op` only has to
+	be associative; dynamic and guided hand chunks out
+	in no particular order, so there it must be
+	commutative too.
+*/
+template<typename T>
+struct alignas(64) partial_result
+{
+	std::optional<T> value;
+};
+
+template<typename RandomIt, typename T, typename BinaryOp>
+T parallel_reduce(thread_pool& pool, RandomIt first, RandomIt last, T init, BinaryOp op,
+		parallel_options const& opts = parallel_options())
+{
+	std::size_t const n = static_cast<std::size_t>(last - first);
+	chunk_plan const plan = chunk_plan::make(pool, n, opts);
+	std::vector<partial_result<T>> partials(plan.runners);
+	auto body = [&](unsigned runner, std::size_t begin, std::size_t end) {
+		T acc = first[begin];
+		for (std::size_t i = begin + 1; i < end; ++i)
+			acc = op(std::move(acc), first[i]);
+		std::optional<T>& slot = partials[runner].value;
+		if (slot)
+			*slot = op(std::move(*slot), std::move(acc));
+		else
+			slot.emplace(std::move(acc));
+	};
+	run_chunked(pool, 0, n, plan, opts.schedule, body);
+	for (partial_result<T>& p : partials) {
+		if (p.value)
+			init = op(std::move(init), std::move(*p.value));
+	}
+	return init;
+}
@@ -0,0 +1,661 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#include "FunctionWrapper.hpp"
+#include "NodePool.hpp"
+
+/*
+	Futex-style waiting on a 32-bit atomic word:
+	futex_wait sleeps only while the word still holds
+	`expected`, futex_wake_all wakes everybody sleeping on
+	it. On Linux these are the futex syscall itself. On
+	other platforms a small table of mutex/condition
+	variable pairs, hashed by address, stands in (the
+	waker changes the word before it takes the bucket
+	lock and the waiter re-checks it under that lock, so
+	no wake-up is lost).
+*/
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+	"futex words must be plain 32-bit integers");
+
+#if defined(__linux__)
+
+inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected)
+{
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+		expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wait_for(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+		std::chrono::nanoseconds timeout)
+{
+	if (timeout <= std::chrono::nanoseconds::zero())
+		return;
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+	ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+		expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake_all(std::atomic<std::uint32_t>& word)
+{
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+		INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+struct futex_bucket
+{
+	std::mutex mut;
+	std::condition_variable cond;
+
+	static futex_bucket& for_address(void const* p)
+	{
+		static futex_bucket table[64];
+		return table[(reinterpret_cast<std::uintptr_t>(p) >> 4) % 64];
+	}
+};
+
+inline void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected)
+{
+	futex_bucket& b = futex_bucket::for_address(&word);
+	std::unique_lock<std::mutex> lk(b.mut);
+	if (word.load(std::memory_order_acquire) == expected)
+		b.cond.wait(lk);
+}
+
+inline void futex_wait_for(std::atomic<std::uint32_t>& word, std::uint32_t expected,
+		std::chrono::nanoseconds timeout)
+{
+	futex_bucket& b = futex_bucket::for_address(&word);
+	std::unique_lock<std::mutex> lk(b.mut);
+	if (word.load(std::memory_order_acquire) == expected)
+		b.cond.wait_for(lk, timeout);
+}
+
+inline void futex_wake_all(std::atomic<std::uint32_t>& word)
+{
+	futex_bucket& b = futex_bucket::for_address(&word);
+	std::lock_guard<std::mutex> lk(b.mut);
+	b.cond.notify_all();
+}
+
+#endif
+
+class thread_pool;
+
+// Defined in ThreadPool.hpp; let pool_future::wait help
+// the pool it belongs to instead of sleeping, and let
+// then() schedule continuations on it.
+inline bool pool_is_worker_thread(thread_pool const* pool);
+inline bool pool_run_pending_task(thread_pool* pool);
+inline void pool_post(thread_pool* pool, function_wrapper&& task);
+
+template<typename T>
+class pool_future;
+
+/*
+	Where a then() continuation runs:
+		schedule    posted to the future's pool as a
+		            new task (the default),
+		run_inline  right where the result becomes
+		            available: on the thread that
+		            completes the promise, or in then()
+		            itself if it is already ready. Only
+		            for continuations that are cheap and
+		            never block.
+	A future with no pool (from a free-standing
+	pool_promise) always runs continuations inline.
+*/
+enum class then_policy
+{
+	schedule,
+	run_inline
+};
+
+template<typename T>
+struct unwrapped_future;
+
+template<typename T>
+struct unwrapped_future<pool_future<T>>
+{
+	using type = T;
+};
+
+template<typename T>
+struct future_storage
+{
+	using type = T;
+	static T&& get(type& v) { return std::move(v); }
+};
+
+template<typename T>
+struct future_storage<T&>
+{
+	using type = std::reference_wrapper<T>;
+	static T& get(type& v) { return v.get(); }
+};
+
+template<>
+struct future_storage<void>
+{
+	struct type {};
+	static void get(type&) {}
+};
+
+/*
+	Shared state behind a pool_promise / pool_future pair.
+
+	Everything is in one block from the NodePool, so a
+	warm submit/get allocates nothing. Readiness is one
+	atomic word:
+		has_value / has_error  set once by the promise,
+		waiting                set by a consumer before
+		                       it sleeps on the word,
+		continuation           a callback is attached.
+	The producer publishes with a single exchange and
+	only makes the wake-up syscall if `waiting` was set,
+	so a result that is ready before anybody asks for it
+	costs no syscall on either side. Likewise whoever
+	sees the other side's bit runs the continuation:
+	the producer if it was attached first, the attacher
+	if the result was already there.
+*/
+template<typename T>
+class pool_shared_state
+{
+	private:
+		using storage = future_storage<T>;
+		using stored_type = typename storage::type;
+		using allocator = PoolAllocator<pool_shared_state>;
+
+		static constexpr std::uint32_t has_value = 1;
+		static constexpr std::uint32_t has_error = 2;
+		static constexpr std::uint32_t ready_mask = has_value | has_error;
+		static constexpr std::uint32_t waiting = 4;
+		static constexpr std::uint32_t has_continuation = 8;
+
+		std::atomic<std::uint32_t> state{0};
+		std::atomic<unsigned> refs{1};
+		bool future_retrieved = false;
+		thread_pool* owner;
+		std::exception_ptr error;
+		function_wrapper continuation;
+		alignas(stored_type) unsigned char buffer[sizeof(stored_type)];
+
+		explicit pool_shared_state(thread_pool* pool) : owner(pool) {}
+
+		~pool_shared_state()
+		{
+			if (state.load(std::memory_order_relaxed) & has_value)
+				value().~stored_type();
+		}
+
+		stored_type& value()
+		{
+			return *std::launder(reinterpret_cast<stored_type*>(buffer));
+		}
+
+		void run_continuation()
+		{
+			function_wrapper k(std::move(continuation));
+			k();
+		}
+
+		void publish(std::uint32_t what)
+		{
+			std::uint32_t const old = state.exchange(what, std::memory_order_acq_rel);
+			if (old & waiting)
+				futex_wake_all(state);
+			if (old & has_continuation)
+				run_continuation();
+		}
+
+		// Sets `waiting` unless the result arrived meanwhile;
+		// returns the word to sleep on, 0 if ready.
+		std::uint32_t announce_waiter()
+		{
+			std::uint32_t s = state.load(std::memory_order_acquire);
+			while (!(s & ready_mask) && !(s & waiting)) {
+				if (state.compare_exchange_weak(s, s | waiting, std::memory_order_acq_rel))
+					return s | waiting;
+			}
+			return (s & ready_mask) ? 0 : s;
+		}
+
+	public:
+		static pool_shared_state* create(thread_pool* pool)
+		{
+			return ::new (allocator().allocate(1)) pool_shared_state(pool);
+		}
+
+		void add_ref()
+		{
+			refs.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void release()
+		{
+			if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				this->~pool_shared_state();
+				allocator().deallocate(this, 1);
+			}
+		}
+
+		thread_pool* pool() const
+		{
+			return owner;
+		}
+
+		// Only the promise calls this, from one thread.
+		bool mark_retrieved()
+		{
+			bool const first = !future_retrieved;
+			future_retrieved = true;
+			return first;
+		}
+
+		bool is_ready() const
+		{
+			return (state.load(std::memory_order_acquire) & ready_mask) != 0;
+		}
+
+		template<typename... Args>
+		void set_value(Args&&... args)
+		{
+			::new (buffer) stored_type(std::forward<Args>(args)...);
+			publish(has_value);
+		}
+
+		void set_exception(std::exception_ptr e)
+		{
+			error = std::move(e);
+			publish(has_error);
+		}
+
+		// At most one continuation per state. It must not
+		// throw; the ones pool_future builds catch
+		// everything into their own promise.
+		void set_continuation(function_wrapper&& k)
+		{
+			continuation = std::move(k);
+			std::uint32_t s = state.load(std::memory_order_acquire);
+			while (!(s & ready_mask)) {
+				if (state.compare_exchange_weak(s, s | has_continuation, std::memory_order_acq_rel))
+					return;
+			}
+			run_continuation();
+		}
+
+		void wait()
+		{
+			while (std::uint32_t const s = announce_waiter())
+				futex_wait(state, s);
+		}
+
+		// True if the result is ready.
+		bool wait_until(std::chrono::steady_clock::time_point deadline)
+		{
+			for (;;) {
+				std::uint32_t const s = announce_waiter();
+				if (!s)
+					return true;
+				auto const left = deadline - std::chrono::steady_clock::now();
+				if (left <= std::chrono::steady_clock::duration::zero())
+					return false;
+				futex_wait_for(state, s, std::chrono::duration_cast<std::chrono::nanoseconds>(left));
+			}
+		}
+
+		// Once ready: the value, or the stored exception.
+		T take()
+		{
+			if (state.load(std::memory_order_acquire) & has_error)
+				std::rethrow_exception(error);
+			return storage::get(value());
+		}
+};
+
+/*
+	Producer side. Broken promises behave like
+	std::promise: destroying one that was never satisfied
+	stores a future_error(broken_promise) for the
+	consumer. The shared state only holds a pointer to
+	the pool, so a promise is a single pointer and a
+	small task plus its promise still fits
+	function_wrapper's inline buffer.
+*/
+template<typename T>
+class pool_promise
+{
+	private:
+		pool_shared_state<T>* state;
+
+		void check_unsatisfied() const
+		{
+			if (!state)
+				throw std::future_error(std::future_errc::no_state);
+			if (state->is_ready())
+				throw std::future_error(std::future_errc::promise_already_satisfied);
+		}
+
+	public:
+		explicit pool_promise(thread_pool* pool = nullptr)
+			: state(pool_shared_state<T>::create(pool))
+		{}
+
+		pool_promise(pool_promise&& other) noexcept : state(other.state)
+		{
+			other.state = nullptr;
+		}
+
+		pool_promise& operator=(pool_promise&& other) noexcept
+		{
+			if (this != &other) {
+				pool_promise old(std::move(*this));
+				state = other.state;
+				other.state = nullptr;
+			}
+			return *this;
+		}
+
+		pool_promise(pool_promise const&) = delete;
+		pool_promise& operator=(pool_promise const&) = delete;
+
+		~pool_promise()
+		{
+			if (!state)
+				return;
+			if (!state->is_ready())
+				state->set_exception(std::make_exception_ptr(
+					std::future_error(std::future_errc::broken_promise)));
+			state->release();
+		}
+
+		pool_future<T> get_future()
+		{
+			if (!state)
+				throw std::future_error(std::future_errc::no_state);
+			if (!state->mark_retrieved())
+				throw std::future_error(std::future_errc::future_already_retrieved);
+			state->add_ref();
+			return pool_future<T>(state);
+		}
+
+		template<typename... Args>
+		void set_value(Args&&... args)
+		{
+			check_unsatisfied();
+			state->set_value(std::forward<Args>(args)...);
+		}
+
+		void set_exception(std::exception_ptr e)
+		{
+			check_unsatisfied();
+			state->set_exception(std::move(e));
+		}
+
+		// Run f() and store what it returns, or what it
+		// throws.
+		template<typename F>
+		void set_from(F&& f)
+		{
+			try {
+				if constexpr (std::is_void<T>::value) {
+					std::forward<F>(f)();
+					set_value();
+				} else {
+					set_value(std::forward<F>(f)());
+				}
+			} catch (...) {
+				set_exception(std::current_exception());
+			}
+		}
+};
+
+/*
+	Future returned by thread_pool::submit.
+
+	Called from outside the pool, wait()/get() block on
+	the state word like std::future. Called from one of
+	the pool's own workers they run other queued tasks
+	until the result is ready, so parallel quicksort or
+	a tree reduction can wait on its children without
+	tying up a worker or oversubscribing the machine.
+
+	then(f) chains f(ready_future) onto the result
+	without anyone waiting for it, and returns a future
+	for what f returns; unwrap() turns a future of a
+	future into a plain one, also without waiting.
+	Both consume the future they are called on.
+*/
+template<typename T>
+class pool_future
+{
+	private:
+		pool_shared_state<T>* state;
+
+		static constexpr int idle_yields = 16;
+
+		template<typename U>
+		friend class pool_promise;
+		template<typename U>
+		friend class pool_future;
+
+		explicit pool_future(pool_shared_state<T>* s) noexcept : state(s) {}
+
+		void reset() noexcept
+		{
+			if (state) {
+				state->release();
+				state = nullptr;
+			}
+		}
+
+		void check_valid() const
+		{
+			if (!state)
+				throw std::future_error(std::future_errc::no_state);
+		}
+
+		// Hands the state over to a continuation.
+		pool_shared_state<T>* detach()
+		{
+			check_valid();
+			pool_shared_state<T>* const s = state;
+			state = nullptr;
+			return s;
+		}
+
+		// Complete `p` with this future's outcome once it
+		// is known.
+		void forward_to(pool_promise<T>&& p)
+		{
+			pool_shared_state<T>* const s = detach();
+			s->set_continuation(function_wrapper(
+				[p = std::move(p), ready = pool_future(s)]() mutable {
+					p.set_from([&]() -> T { return ready.get(); });
+				}));
+		}
+
+	public:
+		pool_future() noexcept : state(nullptr) {}
+
+		pool_future(pool_future&& other) noexcept : state(other.state)
+		{
+			other.state = nullptr;
+		}
+
+		pool_future& operator=(pool_future&& other) noexcept
+		{
+			if (this != &other) {
+				reset();
+				state = other.state;
+				other.state = nullptr;
+			}
+			return *this;
+		}
+
+		pool_future(pool_future const&) = delete;
+		pool_future& operator=(pool_future const&) = delete;
+
+		~pool_future()
+		{
+			reset();
+		}
+
+		bool valid() const noexcept { return state != nullptr; }
+
+		// The pool that produces this result, if any.
+		thread_pool* pool() const noexcept { return state ? state->pool() : nullptr; }
+
+		bool is_ready() const
+		{
+			check_valid();
+			return state->is_ready();
+		}
+
+		void wait()
+		{
+			check_valid();
+			thread_pool* const pool = state->pool();
+			if (!pool || !pool_is_worker_thread(pool)) {
+				state->wait();
+				return;
+			}
+			int idle = 0;
+			while (!state->is_ready()) {
+				if (pool_run_pending_task(pool)) {
+					idle = 0;
+				} else if (++idle < idle_yields) {
+					std::this_thread::yield();
+				} else {
+					// Nothing to help with; the task we need is
+					// running elsewhere. Nap briefly and recheck
+					// in case new work shows up meanwhile.
+					state->wait_until(std::chrono::steady_clock::now() + std::chrono::microseconds(50));
+				}
+			}
+		}
+
+		template<typename Rep, typename Period>
+		std::future_status wait_for(std::chrono::duration<Rep, Period> const& timeout) const
+		{
+			check_valid();
+			return state->wait_until(std::chrono::steady_clock::now() +
+					std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout))
+				? std::future_status::ready : std::future_status::timeout;
+		}
+
+		// Like std::future, get() consumes the state.
+		T get()
+		{
+			wait();
+			pool_shared_state<T>* const s = state;
+			state = nullptr;
+			struct releaser
+			{
+				pool_shared_state<T>* s;
+				~releaser() { s->release(); }
+			} guard{s};
+			return s->take();
+		}
+
+		template<typename F>
+		auto then(F&& f)
+		{
+			return then(then_policy::schedule, std::forward<F>(f));
+		}
+
+		template<typename F>
+		auto then(then_policy policy, F&& f)
+			-> pool_future<std::invoke_result_t<std::decay_t<F>, pool_future<T>>>
+		{
+			using result_type = std::invoke_result_t<std::decay_t<F>, pool_future<T>>;
+			pool_shared_state<T>* const s = detach();
+			thread_pool* const pool = s->pool();
+			pool_promise<result_type> promise(pool);
+			pool_future<result_type> res(promise.get_future());
+			auto run = [p = std::move(promise), f = std::forward<F>(f), ready = pool_future(s)]() mutable {
+				p.set_from([&]() -> result_type { return std::move(f)(std::move(ready)); });
+			};
+			if (policy == then_policy::schedule && pool) {
+				s->set_continuation(function_wrapper([pool, run = std::move(run)]() mutable {
+					pool_post(pool, function_wrapper(std::move(run)));
+				}));
+			} else {
+				s->set_continuation(function_wrapper(std::move(run)));
+			}
+			return res;
+		}
+
+		/*
+			Building block for the when_* combinators:
+			consumes this future and returns a new one that
+			takes on the same outcome, then calls after()
+			on whichever thread published it. The new
+			future has its own state, so it can be waited
+			on or given a then() of its own as usual.
+		*/
+		template<typename G>
+		pool_future relay(G&& after)
+		{
+			pool_shared_state<T>* const s = detach();
+			pool_promise<T> promise(s->pool());
+			pool_future res(promise.get_future());
+			s->set_continuation(function_wrapper(
+				[p = std::move(promise), ready = pool_future(s), after = std::forward<G>(after)]() mutable {
+					p.set_from([&]() -> T { return ready.get(); });
+					after();
+				}));
+			return res;
+		}
+
+		template<typename U = T>
+		auto unwrap() -> pool_future<typename unwrapped_future<U>::type>
+		{
+			using inner_type = typename unwrapped_future<U>::type;
+			pool_shared_state<T>* const s = detach();
+			pool_promise<inner_type> promise(s->pool());
+			pool_future<inner_type> res(promise.get_future());
+			s->set_continuation(function_wrapper(
+				[p = std::move(promise), outer = pool_future(s)]() mutable {
+					pool_future<inner_type> inner;
+					try {
+						inner = outer.get();
+					} catch (...) {
+						p.set_exception(std::current_exception());
+						return;
+					}
+					if (!inner.valid()) {
+						p.set_exception(std::make_exception_ptr(
+							std::future_error(std::future_errc::broken_promise)));
+						return;
+					}
+					inner.forward_to(std::move(p));
+				}));
+			return res;
+		}
+};
@@ -0,0 +1,229 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "QueueTelemetry.hpp"
+
+/*
+	Per-worker counters for thread_pool.
+
+	Every worker slot owns one worker_telemetry, on its
+	own cache line, and is the only thread that ever
+	writes to it. So the counters are atomics only so
+	that stats() may read them concurrently: updates are
+	a relaxed load and store, not a locked
+	read-modify-write, and nothing is shared between
+	workers on the hot path.
+
+	Time is attributed without extra clock reads: the
+	pool already reads the clock when a task starts (for
+	the submit-to-start wait), and that same timestamp
+	closes the previous segment, so the start of one task
+	is the end of the last. A worker reads the clock once
+	more when it runs out of work, which closes the busy
+	segment and opens an idle one. Consequently:
+		- busy_ns + idle_ns is wall time since the worker
+		  started (snapshot() adds the open segment),
+		- the run-time sample for a task includes the
+		  (short) pop of the next one, and a task that
+		  waits on a pool_future and runs other tasks in
+		  the meantime is recorded as several segments.
+*/
+struct worker_stats
+{
+	std::uint64_t tasks_run = 0;
+	std::uint64_t busy_ns = 0;
+	std::uint64_t idle_ns = 0;
+	std::uint64_t steals_attempted = 0;
+	std::uint64_t steals_succeeded = 0;
+	std::uint64_t depth_at_pop_sum = 0;	// backlog seen at each pop
+	std::uint64_t depth_at_pop_max = 0;
+	LatencyHistogram wait;			// submit-to-start, ns
+	LatencyHistogram run;			// run time, ns
+
+	double mean_depth_at_pop() const
+	{
+		return tasks_run ? static_cast<double>(depth_at_pop_sum) / static_cast<double>(tasks_run) : 0.0;
+	}
+
+	double utilisation() const
+	{
+		std::uint64_t const total = busy_ns + idle_ns;
+		return total ? static_cast<double>(busy_ns) / static_cast<double>(total) : 0.0;
+	}
+
+	worker_stats& operator+=(worker_stats const& o)
+	{
+		tasks_run += o.tasks_run;
+		busy_ns += o.busy_ns;
+		idle_ns += o.idle_ns;
+		steals_attempted += o.steals_attempted;
+		steals_succeeded += o.steals_succeeded;
+		depth_at_pop_sum += o.depth_at_pop_sum;
+		if (o.depth_at_pop_max > depth_at_pop_max)
+			depth_at_pop_max = o.depth_at_pop_max;
+		for (std::size_t i = 0; i < LatencyHistogram::bucket_count; ++i) {
+			wait.buckets[i] += o.wait.buckets[i];
+			run.buckets[i] += o.run.buckets[i];
+		}
+		return *this;
+	}
+};
+
+struct pool_stats
+{
+	std::vector<worker_stats> workers;	// indexed by worker slot
+	worker_stats total;
+};
+
+class alignas(64) worker_telemetry
+{
+	private:
+		using clock = std::chrono::steady_clock;
+		using counter = std::atomic<std::uint64_t>;
+		using histogram = std::array<counter, LatencyHistogram::bucket_count>;
+
+		counter tasks_run{0};
+		counter busy_ns{0};
+		counter idle_ns{0};
+		counter steals_attempted{0};
+		counter steals_succeeded{0};
+		counter depth_sum{0};
+		counter depth_max{0};
+		histogram wait{};
+		histogram run{};
+		// Plain submits only, for thread_pool::scheduling_stats().
+		counter normal_started{0};
+		histogram normal_wait{};
+
+		// Start of the open segment; written by the owner,
+		// read by snapshot().
+		std::atomic<clock::duration::rep> mark{0};
+		std::atomic<bool> busy{false};
+
+		static std::uint64_t to_ns(clock::duration d)
+		{
+			auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+			return ns > 0 ? static_cast<std::uint64_t>(ns) : 0;
+		}
+
+		// Single writer: no need for a locked add.
+		static void add(counter& c, std::uint64_t v)
+		{
+			c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+		}
+
+		static void record(histogram& h, std::uint64_t ns)
+		{
+			add(h[LatencyHistogram::bucket_for(ns)], 1);
+		}
+
+		static void read(LatencyHistogram& out, histogram const& h)
+		{
+			for (std::size_t i = 0; i < LatencyHistogram::bucket_count; ++i)
+				out.buckets[i] = h[i].load(std::memory_order_relaxed);
+		}
+
+		clock::duration since_mark(clock::time_point now) const
+		{
+			return now.time_since_epoch() - clock::duration(mark.load(std::memory_order_relaxed));
+		}
+
+		void close_segment(clock::time_point now, bool next_busy)
+		{
+			std::uint64_t const ns = to_ns(since_mark(now));
+			if (busy.load(std::memory_order_relaxed)) {
+				add(busy_ns, ns);
+				record(run, ns);
+			} else {
+				add(idle_ns, ns);
+			}
+			mark.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+			busy.store(next_busy, std::memory_order_relaxed);
+		}
+
+	public:
+		void on_worker_start(clock::time_point now)
+		{
+			mark.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+			busy.store(false, std::memory_order_relaxed);
+		}
+
+		void on_worker_stop(clock::time_point now)
+		{
+			close_segment(now, false);
+			mark.store(0, std::memory_order_relaxed);
+		}
+
+		// `depth`: tasks queued in the shared queues and on
+		// this worker's own deque, this one included (other
+		// workers' deques are not looked at).
+		void on_task_start(clock::time_point now, clock::duration waited, std::size_t depth)
+		{
+			close_segment(now, true);
+			add(tasks_run, 1);
+			record(wait, to_ns(waited));
+			add(depth_sum, depth);
+			if (depth > depth_max.load(std::memory_order_relaxed))
+				depth_max.store(depth, std::memory_order_relaxed);
+		}
+
+		void on_normal_start(clock::duration waited)
+		{
+			add(normal_started, 1);
+			record(normal_wait, to_ns(waited));
+		}
+
+		bool is_busy() const
+		{
+			return busy.load(std::memory_order_relaxed);
+		}
+
+		void on_out_of_work(clock::time_point now)
+		{
+			close_segment(now, false);
+		}
+
+		void on_steal(bool succeeded)
+		{
+			add(steals_attempted, 1);
+			if (succeeded)
+				add(steals_succeeded, 1);
+		}
+
+		void add_normal_to(std::uint64_t& started, LatencyHistogram& waits) const
+		{
+			started += normal_started.load(std::memory_order_relaxed);
+			for (std::size_t i = 0; i < LatencyHistogram::bucket_count; ++i)
+				waits.buckets[i] += normal_wait[i].load(std::memory_order_relaxed);
+		}
+
+		// Relaxed reads of live counters: each value is
+		// exact, but they are not one consistent cut.
+		worker_stats snapshot(clock::time_point now = clock::now()) const
+		{
+			worker_stats s;
+			s.tasks_run = tasks_run.load(std::memory_order_relaxed);
+			s.busy_ns = busy_ns.load(std::memory_order_relaxed);
+			s.idle_ns = idle_ns.load(std::memory_order_relaxed);
+			s.steals_attempted = steals_attempted.load(std::memory_order_relaxed);
+			s.steals_succeeded = steals_succeeded.load(std::memory_order_relaxed);
+			s.depth_at_pop_sum = depth_sum.load(std::memory_order_relaxed);
+			s.depth_at_pop_max = depth_max.load(std::memory_order_relaxed);
+			read(s.wait, wait);
+			read(s.run, run);
+			// mark == 0: the slot has no running worker.
+			if (mark.load(std::memory_order_relaxed) != 0) {
+				std::uint64_t const open = to_ns(since_mark(now));
+				if (busy.load(std::memory_order_relaxed))
+					s.busy_ns += open;
+				else
+					s.idle_ns += open;
+			}
+			return s;
+		}
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "QueueTelemetry.hpp"
+
+/*
+	Building blocks for the pool's priority and deadline
+	scheduling.
+
+	Tasks fall into four scheduling classes:
+		high      submit_with_priority(task_priority::high, ...)
+		normal    plain submit (work-stealing deques)
+		low       submit_with_priority(task_priority::low, ...)
+		deadline  submit_by_deadline(tp, ...), earliest first
+*/
+
+enum class task_priority : unsigned
+{
+	high = 0,
+	normal = 1,
+	low = 2
+};
+
+enum class scheduling_class : unsigned
+{
+	high = 0,
+	normal = 1,
+	low = 2,
+	deadline = 3
+};
+
+constexpr std::size_t scheduling_class_count = 4;
+
+struct scheduling_class_stats
+{
+	std::size_t depth = 0;			// queued right now
+	std::uint64_t started = 0;		// tasks picked up so far
+	LatencyHistogram wait;			// submit-to-start, ns
+};
+
+/*
+	Lock-free counters behind scheduling_class_stats for
+	the high, low and deadline classes. Depth goes up on
+	enqueue and down when a task is picked; the wait
+	histogram uses the same log2 buckets as the queue
+	telemetry. Each class has its own cache line, and
+	these tasks already go through a locked queue, so
+	the extra RMWs stay off the plain submit path.
+
+	Normal tasks are not counted on enqueue at all.
+	Workers record the ones they start in their own
+	worker_telemetry; only a normal task run by a thread
+	outside the pool (run_pending_task) lands here, and
+	thread_pool::scheduling_stats() adds the two up.
+*/
+class scheduling_counters
+{
+	private:
+		struct alignas(64) per_class
+		{
+			std::atomic<std::size_t> depth{0};
+			std::atomic<std::uint64_t> started{0};
+			std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> wait{};
+		};
+
+		per_class classes[scheduling_class_count];
+
+	public:
+		void on_enqueue(scheduling_class c)
+		{
+			if (c != scheduling_class::normal)
+				classes[static_cast<unsigned>(c)].depth.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void on_start(scheduling_class c, std::chrono::nanoseconds waited)
+		{
+			per_class& pc = classes[static_cast<unsigned>(c)];
+			if (c != scheduling_class::normal)
+				pc.depth.fetch_sub(1, std::memory_order_relaxed);
+			pc.started.fetch_add(1, std::memory_order_relaxed);
+			std::uint64_t const ns = waited.count() > 0 ? static_cast<std::uint64_t>(waited.count()) : 0;
+			pc.wait[LatencyHistogram::bucket_for(ns)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Always 0 for the normal class.
+		std::size_t depth(scheduling_class c) const
+		{
+			return classes[static_cast<unsigned>(c)].depth.load(std::memory_order_relaxed);
+		}
+
+		// Tasks waiting in the high, low and deadline queues.
+		std::size_t queued() const
+		{
+			return depth(scheduling_class::high) + depth(scheduling_class::low) +
+				depth(scheduling_class::deadline);
+		}
+
+		std::array<scheduling_class_stats, scheduling_class_count> snapshot() const
+		{
+			std::array<scheduling_class_stats, scheduling_class_count> res;
+			for (std::size_t i = 0; i < scheduling_class_count; ++i) {
+				res[i].depth = classes[i].depth.load(std::memory_order_relaxed);
+				res[i].started = classes[i].started.load(std::memory_order_relaxed);
+				for (std::size_t b = 0; b < LatencyHistogram::bucket_count; ++b)
+					res[i].wait.buckets[b] = classes[i].wait[b].load(std::memory_order_relaxed);
+			}
+			return res;
+		}
+};
+
+/*
+	FIFO for one priority class. Node must have a
+	`submitted` time_point so the pool can age the
+	oldest entry.
+*/
+template<typename Node>
+class class_queue
+{
+	private:
+		mutable std::mutex m;
+		std::deque<Node*> q;
+
+	public:
+		void push(Node* n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			q.push_back(n);
+		}
+
+		bool try_pop(Node*& n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			if (q.empty())
+				return false;
+			n = q.front();
+			q.pop_front();
+			return true;
+		}
+
+		// Pop the front only if it was submitted before `cutoff`.
+		template<typename TimePoint>
+		bool try_pop_older_than(TimePoint cutoff, Node*& n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			if (q.empty() || !(q.front()->submitted < cutoff))
+				return false;
+			n = q.front();
+			q.pop_front();
+			return true;
+		}
+};
+
+/*
+	Earliest-deadline-first queue. Node must have a
+	`deadline` time_point.
+*/
+template<typename Node>
+class deadline_queue
+{
+	private:
+		struct later
+		{
+			bool operator()(Node const* a, Node const* b) const { return b->deadline < a->deadline; }
+		};
+
+		mutable std::mutex m;
+		std::vector<Node*> heap;
+
+	public:
+		void push(Node* n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			heap.push_back(n);
+			std::push_heap(heap.begin(), heap.end(), later());
+		}
+
+		bool try_pop(Node*& n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			if (heap.empty())
+				return false;
+			std::pop_heap(heap.begin(), heap.end(), later());
+			n = heap.back();
+			heap.pop_back();
+			return true;
+		}
+
+		// Pop the earliest task only if its deadline is before `cutoff`.
+		template<typename TimePoint>
+		bool try_pop_due_before(TimePoint cutoff, Node*& n)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			if (heap.empty() || !(heap.front()->deadline < cutoff))
+				return false;
+			std::pop_heap(heap.begin(), heap.end(), later());
+			n = heap.back();
+			heap.pop_back();
+			return true;
+		}
+};
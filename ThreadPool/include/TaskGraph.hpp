@@ -0,0 +1,323 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "FunctionWrapper.hpp"
+#include "ThreadPool.hpp"
+
+/*
+	Dependency-counted task graph.
+
+	Instead of chaining stages by blocking on
+	future::get() (Futures_1.cc), describe the job as a
+	DAG and let the pool run it:
+
+		task_graph g;
+		auto map  = g.add([&]{ load_map(); }, "map");
+		auto mesh = g.add([&]{ build_navmesh(); }, "navmesh");
+		auto path = g.add([&]{ plan_paths(); }, "paths");
+		g.precede(map, mesh);
+		g.precede(mesh, path);
+		g.run(pool);
+
+	Each node keeps an atomic count of unfinished
+	predecessors. A finishing node decrements its
+	successors' counts; whoever takes one to zero makes
+	that successor ready. One ready successor runs
+	straight away on the same worker, the rest are
+	posted to the pool, so no worker ever waits for a
+	dependency.
+
+	The structure is built once and run any number of
+	times: run() only resets the counters, and a posted
+	node is a two-word function_wrapper in a recycled
+	pool node, so a warm rerun allocates nothing.
+
+	Every run records when each node started and how
+	long it took; timings() returns them and
+	critical_path() the longest chain through the graph
+	by those durations.
+
+	If a node throws, nodes that have not started yet
+	skip their work (their counters still drain so the
+	run completes) and run() rethrows the first
+	exception. A graph must not be modified or run again
+	while a run is in progress.
+*/
+class task_graph
+{
+	public:
+		using node_id = std::size_t;
+		using clock = std::chrono::steady_clock;
+
+		struct node_timing
+		{
+			std::string name;
+			std::chrono::nanoseconds start;	// from the start of run()
+			std::chrono::nanoseconds duration;
+		};
+
+		struct path
+		{
+			std::vector<node_id> nodes;
+			std::chrono::nanoseconds length;
+		};
+
+	private:
+		static constexpr node_id none = std::numeric_limits<node_id>::max();
+		static constexpr int idle_yields = 16;
+
+		struct node
+		{
+			function_wrapper work;
+			std::string name;
+			std::vector<node_id> successors;
+			unsigned predecessors = 0;
+			std::atomic<unsigned> remaining{0};
+			clock::time_point start;
+			clock::time_point finish;
+
+			node(function_wrapper&& w, std::string&& n) : work(std::move(w)), name(std::move(n)) {}
+		};
+
+		// deque: growing it never moves existing nodes
+		// (they hold atomics).
+		std::deque<node> nodes;
+		std::vector<node_id> roots;
+		std::vector<node_id> topo_order;
+		bool dirty = false;
+
+		thread_pool* pool = nullptr;
+		clock::time_point run_start;
+		clock::time_point run_finish;
+		std::atomic<std::size_t> outstanding{0};
+		std::atomic<bool> failed{false};
+		std::exception_ptr error;
+		std::mutex done_mutex;
+		std::condition_variable done_cond;
+		std::atomic<bool> finished{true};
+
+		// Kahn's algorithm; also finds the roots and
+		// rejects cycles, which would otherwise hang run().
+		void prepare()
+		{
+			std::vector<unsigned> indegree(nodes.size());
+			for (node const& n : nodes) {
+				for (node_id s : n.successors)
+					++indegree[s];
+			}
+			roots.clear();
+			topo_order.clear();
+			for (node_id i = 0; i < nodes.size(); ++i) {
+				nodes[i].predecessors = indegree[i];
+				if (indegree[i] == 0) {
+					roots.push_back(i);
+					topo_order.push_back(i);
+				}
+			}
+			for (std::size_t k = 0; k < topo_order.size(); ++k) {
+				for (node_id s : nodes[topo_order[k]].successors) {
+					if (--indegree[s] == 0)
+						topo_order.push_back(s);
+				}
+			}
+			if (topo_order.size() != nodes.size())
+				throw std::logic_error("task_graph contains a cycle");
+			dirty = false;
+		}
+
+		void schedule(node_id id)
+		{
+			pool->post([this, id]{ execute(id); });
+		}
+
+		void execute(node_id id)
+		{
+			while (id != none) {
+				node& n = nodes[id];
+				n.start = clock::now();
+				if (!failed.load(std::memory_order_relaxed)) {
+					try {
+						n.work();
+					} catch (...) {
+						record_error(std::current_exception());
+					}
+				}
+				n.finish = clock::now();
+				node_id next = none;
+				for (node_id s : n.successors) {
+					if (nodes[s].remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+						if (next != none)
+							schedule(next);
+						next = s;
+					}
+				}
+				// The graph may be gone once the last node
+				// is accounted for; `next` is still pending
+				// in that case, so this can't be the last.
+				finish_node();
+				id = next;
+			}
+		}
+
+		void finish_node()
+		{
+			if (outstanding.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			std::lock_guard<std::mutex> lk(done_mutex);
+			run_finish = clock::now();
+			finished.store(true, std::memory_order_release);
+			done_cond.notify_all();
+		}
+
+		void record_error(std::exception_ptr e)
+		{
+			std::lock_guard<std::mutex> lk(done_mutex);
+			if (!error)
+				error = e;
+			failed.store(true, std::memory_order_relaxed);
+		}
+
+		// A worker running a nested graph helps with queued
+		// tasks instead of blocking, like pool_future::wait.
+		void wait_for_completion()
+		{
+			if (!pool->is_worker_thread()) {
+				std::unique_lock<std::mutex> lk(done_mutex);
+				done_cond.wait(lk, [this]{ return finished.load(std::memory_order_acquire); });
+				return;
+			}
+			int idle = 0;
+			while (!finished.load(std::memory_order_acquire)) {
+				if (pool->run_pending_task()) {
+					idle = 0;
+				} else if (++idle < idle_yields) {
+					std::this_thread::yield();
+				} else {
+					std::unique_lock<std::mutex> lk(done_mutex);
+					done_cond.wait_for(lk, std::chrono::microseconds(50),
+						[this]{ return finished.load(std::memory_order_acquire); });
+				}
+			}
+			// The last node sets `finished` under the mutex;
+			// taking it once here makes sure that thread is
+			// done with us before we return.
+			std::lock_guard<std::mutex> lk(done_mutex);
+		}
+
+	public:
+		task_graph() = default;
+		task_graph(task_graph const&) = delete;
+		task_graph& operator=(task_graph const&) = delete;
+
+		template<typename F>
+		node_id add(F&& work, std::string name = std::string())
+		{
+			nodes.emplace_back(function_wrapper(std::forward<F>(work)), std::move(name));
+			dirty = true;
+			return nodes.size() - 1;
+		}
+
+		// `before` must finish before `after` starts.
+		void precede(node_id before, node_id after)
+		{
+			if (before >= nodes.size() || after >= nodes.size())
+				throw std::out_of_range("task_graph::precede: no such node");
+			nodes[before].successors.push_back(after);
+			dirty = true;
+		}
+
+		std::size_t size() const
+		{
+			return nodes.size();
+		}
+
+		/*
+			Run every node once on `pool` and return when
+			all have finished. Throws std::logic_error if
+			the graph has a cycle, and rethrows the first
+			exception a node threw.
+		*/
+		void run(thread_pool& p)
+		{
+			if (dirty)
+				prepare();
+			if (nodes.empty())
+				return;
+			pool = &p;
+			error = nullptr;
+			failed.store(false, std::memory_order_relaxed);
+			for (node& n : nodes)
+				n.remaining.store(n.predecessors, std::memory_order_relaxed);
+			outstanding.store(nodes.size(), std::memory_order_relaxed);
+			finished.store(false, std::memory_order_relaxed);
+			run_start = clock::now();
+			for (node_id r : roots)
+				schedule(r);
+			wait_for_completion();
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+		// Wall time of the last run.
+		std::chrono::nanoseconds elapsed() const
+		{
+			return run_finish - run_start;
+		}
+
+		// Per node, indexed by node_id, for the last run.
+		std::vector<node_timing> timings() const
+		{
+			std::vector<node_timing> res;
+			res.reserve(nodes.size());
+			for (node const& n : nodes)
+				res.push_back(node_timing{n.name, n.start - run_start, n.finish - n.start});
+			return res;
+		}
+
+		/*
+			Longest chain of dependent nodes, weighted by
+			the durations of the last run: the part of the
+			job no amount of extra workers can speed up.
+		*/
+		path critical_path()
+		{
+			if (dirty)
+				prepare();
+			std::vector<clock::duration> longest(nodes.size(), clock::duration::zero());
+			std::vector<node_id> via(nodes.size(), none);
+			for (node_id id : topo_order) {
+				node const& n = nodes[id];
+				clock::duration const through = longest[id] + (n.finish - n.start);
+				for (node_id s : n.successors) {
+					if (through > longest[s]) {
+						longest[s] = through;
+						via[s] = id;
+					}
+				}
+			}
+			path res{{}, std::chrono::nanoseconds::zero()};
+			node_id end = none;
+			for (node_id id = 0; id < nodes.size(); ++id) {
+				clock::duration const total = longest[id] + (nodes[id].finish - nodes[id].start);
+				if (end == none || total > res.length) {
+					res.length = total;
+					end = id;
+				}
+			}
+			for (node_id id = end; id != none; id = via[id])
+				res.nodes.insert(res.nodes.begin(), id);
+			return res;
+		}
+};
@@ -0,0 +1,922 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ChaseLevDeque.hpp"
+#include "CpuTopology.hpp"
+#include "FunctionWrapper.hpp"
+#include "NodePool.hpp"
+#include "PoolFuture.hpp"
+#include "PoolTelemetry.hpp"
+#include "PriorityScheduling.hpp"
+#include "ThreadSafeQueue.hpp"
+
+/*
+	RAII joiner: joins every thread in the vector when it
+	goes out of scope, so a pool can never leak running
+	threads even if its constructor throws half-way.
+*/
+class join_threads
+{
+	private:
+		std::vector<std::thread>& threads;
+
+	public:
+		explicit join_threads(std::vector<std::thread>& threads_) : threads(threads_) {}
+
+		~join_threads()
+		{
+			for (std::thread& t : threads) {
+				if (t.joinable())
+					t.join();
+			}
+		}
+};
+
+/*
+	Construction options.
+
+	pin_threads pins worker i to one CPU (in topology
+	order) with pthread_setaffinity_np, so the OS stops
+	migrating it away from its cache.
+
+	numa_aware groups workers by NUMA node and binds
+	each worker to its node's CPUs (or, with pin_threads
+	too, to one CPU on it, falling back to the whole
+	node if that is refused). Each group gets its own
+	injection queue, and a worker steals from its own
+	node before it goes cross-socket. A worker's deque
+	and counters are allocated by a thread running on
+	its node, so they live in that node's memory.
+	Submitters can target a node with submit_to_node;
+	plain submits from outside the pool go to the node
+	the submitting thread is currently running on.
+	Placements the OS refuses are counted, see
+	affinity_failures().
+
+	min_threads / max_threads make the pool elastic
+	(0 means "same as thread_count", i.e. fixed size).
+	It starts with thread_count workers, clamped to the
+	bounds, and adds one while there are no sleeping
+	workers and either
+		- more than spawn_queue_depth tasks per worker
+		  are waiting, or
+		- a task waited longer than spawn_wait_latency
+		  to start, or nothing has started for that long
+		  (every worker is stuck in blocking I/O).
+	A worker above min_threads that finds no work for
+	keep_alive retires.
+*/
+struct thread_pool_options
+{
+	unsigned thread_count = std::thread::hardware_concurrency();
+	bool pin_threads = false;
+	bool numa_aware = false;
+	unsigned min_threads = 0;
+	unsigned max_threads = 0;
+	std::chrono::milliseconds keep_alive{10000};
+	unsigned spawn_queue_depth = 4;
+	std::chrono::microseconds spawn_wait_latency{1000};
+};
+
+/*
+	Work-stealing thread pool.
+
+	Every worker owns a Chase–Lev deque. A task submitted
+	from inside a worker goes onto that worker's deque
+	(LIFO: the next task it runs is the one it just
+	spawned, which is still hot in cache). Tasks submitted
+	from outside the pool go through a shared injection
+	queue. A worker with nothing local first checks the
+	injection queue and then steals the oldest task from
+	a randomly chosen victim.
+
+	Recursive divide-and-conquer code therefore spreads
+	across the cores instead of serialising on one shared
+	task queue.
+
+	Idle workers spin briefly and then sleep; submit only
+	touches the sleep mutex when somebody is asleep.
+	A push to or pop from a worker's own deque writes
+	nothing shared: only tasks in the shared queues are
+	counted, and a worker about to sleep scans the
+	deques instead (see sleep_until_work). Likewise the
+	per-class scheduling counters only count the high,
+	low and deadline classes; a worker keeps the normal
+	class's numbers in its own telemetry.
+	The destructor lets queued tasks finish first.
+
+	Tasks are move-only function_wrappers living in task
+	nodes from the process-wide NodePool, and so is the
+	future's shared state (PoolFuture.hpp), so once the
+	pool is warm a submit does no heap allocation at all.
+
+	submit returns a pool_future. When a task waits on
+	another pool task's result, get() keeps the worker
+	busy with queued tasks instead of blocking it, so a
+	fixed-size pool cannot deadlock on nested waits.
+
+	submit_with_priority / submit_by_deadline put tasks
+	into separate classes (see PriorityScheduling.hpp).
+	A worker looks for work in this order:
+		1. low-priority tasks older than the aging
+		   threshold, and deadline tasks due within the
+		   deadline slack (anti-starvation),
+		2. high priority,
+		3. deadline tasks, earliest first,
+		4. normal tasks (local deque, injection queue,
+		   stealing),
+		5. low priority.
+	Every fairness_interval-th pick a worker tries the
+	normal class before high, so a flood of high-priority
+	work cannot starve plain submits completely.
+	scheduling_stats() reports per-class depth and
+	submit-to-start wait time.
+*/
+class thread_pool
+{
+	public:
+		using task_type = function_wrapper;
+
+	private:
+		// The deques hold plain pointers; the node is what
+		// gets recycled between submits.
+		using clock = std::chrono::steady_clock;
+
+		struct task_node
+		{
+			task_type task;
+			clock::time_point submitted;
+			clock::time_point deadline;
+			scheduling_class cls;
+			bool counted = false;	// included in `pending`
+
+			task_node(task_type&& t, scheduling_class c, clock::time_point due)
+				: task(std::move(t)), submitted(clock::now()), deadline(due), cls(c)
+			{}
+		};
+		using node_allocator = PoolAllocator<task_node>;
+		using task_deque = ChaseLevDeque<task_node*>;
+
+		static constexpr int idle_spins = 64;
+		static constexpr unsigned fairness_interval = 8;
+
+		std::atomic<bool> done;
+		// Normal tasks waiting in the injection queues. The
+		// class queues are counted by `counters`, worker
+		// deques not at all.
+		std::atomic<std::size_t> pending;
+		std::atomic<unsigned> sleepers;
+		std::mutex sleep_mutex;
+		std::condition_variable wake_cond;
+
+		cpu_topology topology;
+		// One injection queue per node group; a single group
+		// unless the pool was built numa_aware. Only nodes
+		// that got workers form a group; node_group maps
+		// every topology node to one.
+		std::vector<std::unique_ptr<ThreadSafeQueue<task_node*>>> injection_queues;
+		std::vector<std::vector<unsigned>> node_workers;
+		std::vector<unsigned> node_group;
+		std::vector<unsigned> worker_node;
+		std::vector<cpu_topology::cpu> worker_cpu;
+		bool numa_binding;
+		std::atomic<unsigned> placement_failures;
+		std::vector<std::unique_ptr<task_deque>> queues;
+		std::vector<std::unique_ptr<worker_telemetry>> worker_counters;
+		class_queue<task_node> high_queue;
+		class_queue<task_node> low_queue;
+		deadline_queue<task_node> deadline_tasks;
+		scheduling_counters counters;
+		std::atomic<clock::duration::rep> low_aging;
+		std::atomic<clock::duration::rep> deadline_slack;
+
+		// Elastic sizing. Every per-worker structure is
+		// sized for max_workers up front, so a worker slot
+		// can be started and retired without touching data
+		// other threads are reading; scale_mutex guards
+		// which slots are live and the thread objects.
+		unsigned min_workers;
+		unsigned max_workers;
+		bool pin_workers;
+		clock::duration keep_alive;
+		clock::duration spawn_latency;
+		unsigned spawn_depth;
+		std::atomic<unsigned> active_workers;
+		std::atomic<clock::duration::rep> last_start;
+		std::mutex scale_mutex;
+		std::vector<char> slot_live;
+		std::vector<std::thread> threads;
+		join_threads joiner;
+
+		static thread_local thread_pool* current_pool;
+		static thread_local unsigned my_index;
+		static thread_local unsigned my_node;
+
+		static std::uint64_t next_random()
+		{
+			static thread_local std::uint64_t state =
+				std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		bool on_worker_thread() const
+		{
+			return current_pool == this;
+		}
+
+		unsigned submit_node() const
+		{
+			if (on_worker_thread())
+				return my_node;
+			if (injection_queues.size() == 1)
+				return 0;
+			return node_group[topology.current_node()];
+		}
+
+		void enqueue(task_type&& t, scheduling_class cls = scheduling_class::normal,
+				clock::time_point due = clock::time_point::max(), int node = -1)
+		{
+			task_node* const task = ::new (node_allocator().allocate(1)) task_node(std::move(t), cls, due);
+			counters.on_enqueue(cls);
+			task->counted = cls == scheduling_class::normal && (node >= 0 || !on_worker_thread());
+			if (task->counted)
+				pending.fetch_add(1, std::memory_order_relaxed);
+			switch (cls) {
+				case scheduling_class::high:
+					high_queue.push(task);
+					break;
+				case scheduling_class::low:
+					low_queue.push(task);
+					break;
+				case scheduling_class::deadline:
+					deadline_tasks.push(task);
+					break;
+				case scheduling_class::normal:
+					if (node >= 0)
+						injection_queues[static_cast<std::size_t>(node) % injection_queues.size()]->push(task);
+					else if (on_worker_thread())
+						queues[my_index]->push(task);
+					else
+						injection_queues[submit_node()]->push(task);
+					break;
+			}
+			// Pairs with the fence in sleep_until_work: either
+			// we see the sleeper, or it sees our task.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleepers.load(std::memory_order_relaxed) > 0) {
+				std::lock_guard<std::mutex> lk(sleep_mutex);
+				wake_cond.notify_one();
+			} else if (elastic()) {
+				std::size_t const waiting = queued_estimate();
+				clock::duration const stalled = task->submitted.time_since_epoch() -
+					clock::duration(last_start.load(std::memory_order_relaxed));
+				if (waiting > std::size_t(spawn_depth) * active_workers.load(std::memory_order_relaxed) ||
+						(waiting > 1 && stalled > spawn_latency))
+					grow();
+			}
+		}
+
+		bool elastic() const
+		{
+			return min_workers < max_workers;
+		}
+
+		// Shared queues plus our own deque; cheap, and all
+		// the hot paths need.
+		std::size_t queued_estimate() const
+		{
+			std::size_t n = pending.load(std::memory_order_relaxed) + counters.queued();
+			if (on_worker_thread())
+				n += static_cast<std::size_t>(queues[my_index]->size());
+			return n;
+		}
+
+		// Exact enough to decide whether to sleep or exit:
+		// looks at every deque, so only for idle paths.
+		bool has_work() const
+		{
+			if (pending.load(std::memory_order_relaxed) != 0 || counters.queued() != 0)
+				return true;
+			for (std::unique_ptr<task_deque> const& q : queues) {
+				if (!q->empty())
+					return true;
+			}
+			return false;
+		}
+
+		void start_worker(unsigned index)
+		{
+			threads[index] = std::thread(&thread_pool::worker_thread, this, index);
+		}
+
+		// Runs on the worker itself, before it looks for work.
+		void place_worker(unsigned index)
+		{
+			cpu_topology::cpu const& c = worker_cpu[index];
+			if (pin_workers) {
+				if (cpu_topology::bind_current_thread({c.id}))
+					return;
+				placement_failures.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (numa_binding && !cpu_topology::bind_current_thread(topology.node_cpus(c.node)) &&
+					!pin_workers)
+				placement_failures.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/*
+			Allocate the per-worker deques and counters. With
+			several node groups each group's are allocated on
+			a short-lived thread bound to that node, so first
+			touch places them in the node's memory rather
+			than the constructing thread's. If that thread
+			can't be started we allocate here instead.
+		*/
+		void allocate_worker_slots()
+		{
+			queues.resize(max_workers);
+			worker_counters.resize(max_workers);
+			auto const allocate = [this](unsigned group) {
+				for (unsigned i : node_workers[group]) {
+					queues[i].reset(new task_deque);
+					worker_counters[i].reset(new worker_telemetry);
+				}
+			};
+			if (node_workers.size() == 1) {
+				allocate(0);
+				return;
+			}
+			for (unsigned g = 0; g < node_workers.size(); ++g) {
+				std::exception_ptr error;
+				try {
+					std::thread([&, g]{
+						try {
+							cpu_topology::bind_current_thread(
+								topology.node_cpus(worker_cpu[node_workers[g].front()].node));
+							allocate(g);
+						} catch (...) {
+							error = std::current_exception();
+						}
+					}).join();
+				} catch (std::system_error const&) {
+					allocate(g);
+				}
+				if (error)
+					std::rethrow_exception(error);
+			}
+		}
+
+		/*
+			Start one more worker if we are below the cap.
+			Called on the submit path, so it never waits for
+			another thread that is already growing the pool,
+			and a failure to create a thread just leaves the
+			pool at its current size.
+		*/
+		void grow()
+		{
+			std::unique_lock<std::mutex> lk(scale_mutex, std::try_to_lock);
+			if (!lk.owns_lock() || done.load(std::memory_order_relaxed) ||
+					active_workers.load(std::memory_order_relaxed) >= max_workers)
+				return;
+			unsigned index = 0;
+			while (slot_live[index])
+				++index;
+			// A retired worker may still be on its way out.
+			if (threads[index].joinable())
+				threads[index].join();
+			slot_live[index] = 1;
+			active_workers.fetch_add(1, std::memory_order_relaxed);
+			try {
+				start_worker(index);
+			} catch (std::system_error const&) {
+				slot_live[index] = 0;
+				active_workers.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		/*
+			Called by an idle worker after keep_alive. Only
+			the owner pushes to a worker's deque, and an idle
+			worker has already found its own deque empty, so
+			nothing is stranded when it leaves; everything
+			else sits in shared queues the remaining workers
+			(at least min_workers of them) keep draining.
+		*/
+		bool try_retire()
+		{
+			std::lock_guard<std::mutex> lk(scale_mutex);
+			if (done.load(std::memory_order_relaxed) ||
+					active_workers.load(std::memory_order_relaxed) <= min_workers)
+				return false;
+			slot_live[my_index] = 0;
+			active_workers.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		bool pop_task_from_local_queue(task_node*& task)
+		{
+			return on_worker_thread() && queues[my_index]->pop(task);
+		}
+
+		// Own node's queue first, then the other nodes'.
+		bool pop_task_from_injection_queue(task_node*& task)
+		{
+			std::size_t const n = injection_queues.size();
+			std::size_t const home = on_worker_thread() ? my_node : 0;
+			for (std::size_t i = 0; i < n; ++i) {
+				if (injection_queues[(home + i) % n]->try_pop(task))
+					return true;
+			}
+			return false;
+		}
+
+		bool steal_from(std::vector<unsigned> const& victims, task_node*& task)
+		{
+			std::size_t const n = victims.size();
+			if (n == 0)
+				return false;
+			std::size_t const start = static_cast<std::size_t>(next_random() % n);
+			for (std::size_t i = 0; i < n; ++i) {
+				unsigned const victim = victims[(start + i) % n];
+				if (!on_worker_thread()) {
+					if (queues[victim]->steal(task))
+						return true;
+					continue;
+				}
+				if (victim == my_index)
+					continue;
+				bool const stolen = queues[victim]->steal(task);
+				worker_counters[my_index]->on_steal(stolen);
+				if (stolen)
+					return true;
+			}
+			return false;
+		}
+
+		// Victims on our own node first, then cross-node.
+		bool pop_task_from_other_thread_queue(task_node*& task)
+		{
+			std::size_t const nodes = node_workers.size();
+			std::size_t const home = on_worker_thread() ? my_node : 0;
+			for (std::size_t i = 0; i < nodes; ++i) {
+				if (steal_from(node_workers[(home + i) % nodes], task))
+					return true;
+			}
+			return false;
+		}
+
+		bool has_queued(scheduling_class c) const
+		{
+			return counters.depth(c) != 0;
+		}
+
+		bool pop_normal_task(task_node*& task)
+		{
+			return pop_task_from_local_queue(task) ||
+				pop_task_from_injection_queue(task) ||
+				pop_task_from_other_thread_queue(task);
+		}
+
+		// Only reads the clock when there is something to age.
+		bool pop_starving_task(task_node*& task)
+		{
+			if (has_queued(scheduling_class::deadline) &&
+					deadline_tasks.try_pop_due_before(
+						clock::now() + clock::duration(deadline_slack.load(std::memory_order_relaxed)), task))
+				return true;
+			return has_queued(scheduling_class::low) &&
+				low_queue.try_pop_older_than(
+					clock::now() - clock::duration(low_aging.load(std::memory_order_relaxed)), task);
+		}
+
+		bool pop_prioritised_task(task_node*& task)
+		{
+			static thread_local unsigned picks = 0;
+			bool const normal_first = (++picks % fairness_interval) == 0;
+			if (normal_first && pop_normal_task(task))
+				return true;
+			if (pop_starving_task(task))
+				return true;
+			if (has_queued(scheduling_class::high) && high_queue.try_pop(task))
+				return true;
+			if (has_queued(scheduling_class::deadline) && deadline_tasks.try_pop(task))
+				return true;
+			if (!normal_first && pop_normal_task(task))
+				return true;
+			return has_queued(scheduling_class::low) && low_queue.try_pop(task);
+		}
+
+		bool take_task(task_node*& task)
+		{
+			if (pop_prioritised_task(task)) {
+				if (task->counted)
+					pending.fetch_sub(1, std::memory_order_relaxed);
+				clock::time_point const now = clock::now();
+				clock::duration const waited = now - task->submitted;
+				if (on_worker_thread()) {
+					worker_telemetry& w = *worker_counters[my_index];
+					if (task->cls == scheduling_class::normal)
+						w.on_normal_start(waited);
+					else
+						counters.on_start(task->cls, waited);
+					w.on_task_start(now, waited, queued_estimate() + 1);
+				} else {
+					counters.on_start(task->cls, waited);
+				}
+				if (elastic()) {
+					last_start.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+					if (waited > spawn_latency && sleepers.load(std::memory_order_relaxed) == 0 &&
+							has_work())
+						grow();
+				}
+				return true;
+			}
+			return false;
+		}
+
+		/*
+			The task and the future for its result. The
+			task owns the promise (one pointer), so a small
+			callable still fits function_wrapper's buffer
+			and the only other memory involved is the
+			recycled shared state.
+		*/
+		template<typename F, typename... Args>
+		auto package(F&& f, Args&&... args)
+		{
+			using result_type = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+			pool_promise<result_type> promise(this);
+			pool_future<result_type> res(promise.get_future());
+			task_type task([promise = std::move(promise), f = std::forward<F>(f),
+					tup = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+				promise.set_from([&]() -> result_type {
+					return std::apply(std::move(f), std::move(tup));
+				});
+			});
+			return std::make_pair(std::move(task), std::move(res));
+		}
+
+		// Submitted tasks catch everything into their
+		// promise; for a posted one this is where an escaping
+		// exception ends, rather than unwinding into whatever
+		// task happened to be waiting in run_pending_task().
+		static void invoke(task_type& task) noexcept
+		{
+			task();
+		}
+
+		/*
+			Returns false if an elastic pool's keep_alive ran
+			out with no work showing up.
+
+			Registering as a sleeper and then looking at the
+			queues, with a full fence in between, is the
+			mirror image of enqueue's push, fence, check for
+			sleepers: at least one side sees the other. The
+			look is under sleep_mutex, which a waking
+			submitter takes, so its notify can't slip in
+			between the look and the wait.
+		*/
+		bool sleep_until_work()
+		{
+			std::unique_lock<std::mutex> lk(sleep_mutex);
+			sleepers.fetch_add(1, std::memory_order_relaxed);
+			auto const woken = [this]{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				return done.load(std::memory_order_relaxed) || has_work();
+			};
+			bool ready = true;
+			if (elastic())
+				ready = wake_cond.wait_for(lk, keep_alive, woken);
+			else
+				wake_cond.wait(lk, woken);
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+			return ready;
+		}
+
+		void worker_thread(unsigned index)
+		{
+			place_worker(index);
+			my_index = index;
+			my_node = worker_node[index];
+			current_pool = this;
+			worker_telemetry& stats = *worker_counters[index];
+			stats.on_worker_start(clock::now());
+			int idle = 0;
+			for (;;) {
+				if (run_pending_task()) {
+					idle = 0;
+					continue;
+				}
+				if (stats.is_busy())
+					stats.on_out_of_work(clock::now());
+				if (done.load(std::memory_order_acquire) && !has_work())
+					break;
+				if (++idle < idle_spins) {
+					std::this_thread::yield();
+					continue;
+				}
+				idle = 0;
+				if (!sleep_until_work() && try_retire())
+					break;
+			}
+			stats.on_worker_stop(clock::now());
+			current_pool = nullptr;
+		}
+
+	public:
+		explicit thread_pool(unsigned thread_count = std::thread::hardware_concurrency())
+			: thread_pool(thread_pool_options{thread_count})
+		{}
+
+		explicit thread_pool(thread_pool_options const& options)
+			: done(false), pending(0), sleepers(0),
+			  topology(cpu_topology::detect()),
+			  numa_binding(options.numa_aware),
+			  placement_failures(0),
+			  low_aging(std::chrono::duration_cast<clock::duration>(std::chrono::milliseconds(50)).count()),
+			  deadline_slack(std::chrono::duration_cast<clock::duration>(std::chrono::milliseconds(1)).count()),
+			  pin_workers(options.pin_threads),
+			  keep_alive(options.keep_alive),
+			  spawn_latency(options.spawn_wait_latency),
+			  spawn_depth(options.spawn_queue_depth ? options.spawn_queue_depth : 1),
+			  active_workers(0),
+			  last_start(clock::now().time_since_epoch().count()),
+			  joiner(threads)
+		{
+			unsigned const requested = options.thread_count ? options.thread_count : 1;
+			min_workers = options.min_threads ? options.min_threads : requested;
+			max_workers = options.max_threads ? options.max_threads : requested;
+			if (max_workers < min_workers)
+				max_workers = min_workers;
+			unsigned const thread_count = requested < min_workers ? min_workers :
+				requested > max_workers ? max_workers : requested;
+			try {
+				// Worker i takes the i-th usable CPU in node
+				// order, so workers fill one node before the next.
+				std::vector<int> group_of(topology.node_count, -1);
+				for (unsigned i = 0; i < max_workers; ++i) {
+					cpu_topology::cpu const& c = topology.cpus[i % topology.cpus.size()];
+					worker_cpu.push_back(c);
+					unsigned group = 0;
+					if (options.numa_aware) {
+						if (group_of[c.node] < 0) {
+							group_of[c.node] = static_cast<int>(node_workers.size());
+							node_workers.emplace_back();
+						}
+						group = static_cast<unsigned>(group_of[c.node]);
+					} else if (node_workers.empty()) {
+						node_workers.emplace_back();
+					}
+					worker_node.push_back(group);
+					node_workers[group].push_back(i);
+				}
+				// Nodes without workers submit round-robin.
+				std::size_t const groups = node_workers.size();
+				for (unsigned n = 0; n < topology.node_count; ++n)
+					node_group.push_back(group_of[n] >= 0 ? static_cast<unsigned>(group_of[n]) : n % groups);
+				for (std::size_t g = 0; g < groups; ++g)
+					injection_queues.emplace_back(new ThreadSafeQueue<task_node*>);
+				allocate_worker_slots();
+				threads.resize(max_workers);
+				slot_live.resize(max_workers, 0);
+				std::lock_guard<std::mutex> lk(scale_mutex);
+				for (unsigned i = 0; i < thread_count; ++i) {
+					start_worker(i);
+					slot_live[i] = 1;
+					active_workers.fetch_add(1, std::memory_order_relaxed);
+				}
+			} catch (...) {
+				shutdown();
+				throw;
+			}
+		}
+
+		thread_pool(thread_pool const&) = delete;
+		thread_pool& operator=(thread_pool const&) = delete;
+
+		~thread_pool()
+		{
+			shutdown();
+		}
+
+		// Workers currently running; changes over time in an
+		// elastic pool.
+		unsigned size() const
+		{
+			return active_workers.load(std::memory_order_relaxed);
+		}
+
+		unsigned min_size() const
+		{
+			return min_workers;
+		}
+
+		unsigned max_size() const
+		{
+			return max_workers;
+		}
+
+		template<typename F, typename... Args>
+		auto submit(F&& f, Args&&... args)
+			-> pool_future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+		{
+			auto job = package(std::forward<F>(f), std::forward<Args>(args)...);
+			enqueue(std::move(job.first));
+			return std::move(job.second);
+		}
+
+		// Fire-and-forget: no future, so nothing beyond the
+		// recycled task node is allocated. An exception
+		// escaping `f` terminates the program, as it would
+		// on a plain std::thread, on whichever thread runs
+		// it: a worker's own loop, or a task that picked it
+		// up while waiting on a pool_future.
+		template<typename F>
+		void post(F&& f)
+		{
+			enqueue(task_type(std::forward<F>(f)));
+		}
+
+		template<typename F, typename... Args>
+		auto submit_with_priority(task_priority level, F&& f, Args&&... args)
+			-> pool_future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+		{
+			auto job = package(std::forward<F>(f), std::forward<Args>(args)...);
+			enqueue(std::move(job.first), static_cast<scheduling_class>(level));
+			return std::move(job.second);
+		}
+
+		// Deadline tasks run earliest-deadline-first, ahead of
+		// normal work; one about to miss its deadline (within
+		// the deadline slack) jumps ahead of high priority too.
+		template<typename F, typename... Args>
+		auto submit_by_deadline(std::chrono::steady_clock::time_point deadline, F&& f, Args&&... args)
+			-> pool_future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+		{
+			auto job = package(std::forward<F>(f), std::forward<Args>(args)...);
+			enqueue(std::move(job.first), scheduling_class::deadline, deadline);
+			return std::move(job.second);
+		}
+
+		// Hint that the task should run on NUMA node `node`
+		// (taken modulo the number of node groups).
+		template<typename F, typename... Args>
+		auto submit_to_node(unsigned node, F&& f, Args&&... args)
+			-> pool_future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>>
+		{
+			auto job = package(std::forward<F>(f), std::forward<Args>(args)...);
+			enqueue(std::move(job.first), scheduling_class::normal,
+				clock::time_point::max(), static_cast<int>(node));
+			return std::move(job.second);
+		}
+
+		// Node groups: nodes that have workers (1 unless
+		// numa_aware).
+		unsigned node_count() const
+		{
+			return static_cast<unsigned>(node_workers.size());
+		}
+
+		// Worker starts whose pinning or node binding the OS
+		// refused (or that are unsupported here); those
+		// workers run wherever the scheduler puts them.
+		unsigned affinity_failures() const
+		{
+			return placement_failures.load(std::memory_order_relaxed);
+		}
+
+		cpu_topology const& cpu_layout() const
+		{
+			return topology;
+		}
+
+		// Low-priority tasks that have waited this long are
+		// promoted ahead of everything else.
+		void set_low_priority_aging(std::chrono::nanoseconds threshold)
+		{
+			low_aging.store(std::chrono::duration_cast<clock::duration>(threshold).count(),
+				std::memory_order_relaxed);
+		}
+
+		// How close to its deadline a task must be to jump
+		// ahead of high-priority work.
+		void set_deadline_slack(std::chrono::nanoseconds slack)
+		{
+			deadline_slack.store(std::chrono::duration_cast<clock::duration>(slack).count(),
+				std::memory_order_relaxed);
+		}
+
+		// Indexed by scheduling_class. The normal class's
+		// depth is read off the injection count and the
+		// deques, so it is approximate while work flows.
+		std::array<scheduling_class_stats, scheduling_class_count> scheduling_stats() const
+		{
+			std::array<scheduling_class_stats, scheduling_class_count> res = counters.snapshot();
+			scheduling_class_stats& normal = res[static_cast<unsigned>(scheduling_class::normal)];
+			normal.depth = pending.load(std::memory_order_relaxed);
+			for (std::unique_ptr<task_deque> const& q : queues)
+				normal.depth += static_cast<std::size_t>(q->size());
+			for (std::unique_ptr<worker_telemetry> const& w : worker_counters)
+				w->add_normal_to(normal.started, normal.wait);
+			return res;
+		}
+
+		/*
+			Per worker slot: tasks run, busy/idle time,
+			steal attempts, backlog at pop, and submit-to-
+			start / run-time histograms (see
+			PoolTelemetry.hpp). Reading never blocks the
+			workers.
+		*/
+		pool_stats stats() const
+		{
+			pool_stats res;
+			res.workers.reserve(worker_counters.size());
+			clock::time_point const now = clock::now();
+			for (std::unique_ptr<worker_telemetry> const& w : worker_counters) {
+				res.workers.push_back(w->snapshot(now));
+				res.total += res.workers.back();
+			}
+			return res;
+		}
+
+		// True when called from one of this pool's workers.
+		bool is_worker_thread() const
+		{
+			return on_worker_thread();
+		}
+
+		// Run one queued task on the calling thread, if any.
+		bool run_pending_task()
+		{
+			task_node* node;
+			if (!take_task(node))
+				return false;
+			struct node_guard
+			{
+				task_node* n;
+				~node_guard()
+				{
+					n->~task_node();
+					node_allocator().deallocate(n, 1);
+				}
+			} guard{node};
+			invoke(node->task);
+			return true;
+		}
+
+		// Wake every worker, let queued tasks finish, then join.
+		// Setting done under scale_mutex means no worker is
+		// started after this point, so `threads` is stable
+		// while we join it.
+		void shutdown()
+		{
+			{
+				std::lock_guard<std::mutex> scale_lk(scale_mutex);
+				std::lock_guard<std::mutex> lk(sleep_mutex);
+				done.store(true, std::memory_order_seq_cst);
+			}
+			wake_cond.notify_all();
+			for (std::thread& t : threads) {
+				if (t.joinable())
+					t.join();
+			}
+		}
+};
+
+inline thread_local thread_pool* thread_pool::current_pool = nullptr;
+inline thread_local unsigned thread_pool::my_index = 0;
+inline thread_local unsigned thread_pool::my_node = 0;
+
+inline bool pool_is_worker_thread(thread_pool const* pool)
+{
+	return pool->is_worker_thread();
+}
+
+inline bool pool_run_pending_task(thread_pool* pool)
+{
+	return pool->run_pending_task();
+}
+
+inline void pool_post(thread_pool* pool, function_wrapper&& task)
+{
+	pool->post(std::move(task));
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <condition_variable>
+
+/*
+	Fixed-capacity MPMC ring (Vyukov style).
+
+	Every slot carries a sequence number. A producer
+	claims slot `pos` when its sequence equals `pos`,
+	writes the value and publishes `pos + 1`. A consumer
+	claims it when the sequence equals `pos + 1`, reads
+	the value and hands the slot back as `pos + N`.
+
+	The enqueue and dequeue cursors sit on their own
+	cache lines so producers and consumers never bounce
+	each other's line. The mutex and condition variables
+	are only touched once a thread actually has to park
+	because the ring is full or empty.
+
+	Once a slot is claimed it must be published, or the
+	ring wedges at that position. So the only thing done
+	with a claimed slot is a move construction, which T
+	must promise not to throw; values come in by value
+	and go out through a local std::optional, and any
+	assignment or allocation for the caller happens
+	after the slot is handed back.
+*/
+template<typename T, std::size_t N>
+class BoundedThreadSafeQueue
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0,
+			"BoundedThreadSafeQueue capacity must be a power of two");
+	static_assert(std::is_nothrow_move_constructible<T>::value,
+			"BoundedThreadSafeQueue needs a noexcept move constructor");
+
+	private:
+		static constexpr std::size_t cache_line = 64;
+		static constexpr std::size_t mask = N - 1;
+		static constexpr int spin_limit = 64;
+
+		struct cell
+		{
+			std::atomic<std::size_t> sequence;
+			alignas(T) unsigned char storage[sizeof(T)];
+
+			T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+		};
+
+		cell buffer[N];
+		alignas(cache_line) std::atomic<std::size_t> enqueue_pos;
+		alignas(cache_line) std::atomic<std::size_t> dequeue_pos;
+
+		alignas(cache_line) std::atomic<int> consumers_waiting;
+		std::atomic<int> producers_waiting;
+		mutable std::mutex mut;
+		std::condition_variable not_empty;
+		std::condition_variable not_full;
+
+		bool has_item() const
+		{
+			std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+			return buffer[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+		}
+
+		bool has_space() const
+		{
+			std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+			return buffer[pos & mask].sequence.load(std::memory_order_acquire) == pos;
+		}
+
+		// Wake a parked thread only if someone announced it is
+		// waiting. The fence pairs with the one in park(): either
+		// we see the waiter, or the waiter sees our slot update.
+		void wake(std::atomic<int>& waiting, std::condition_variable& cond)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting.load(std::memory_order_relaxed) > 0) {
+				std::lock_guard<std::mutex> lk(mut);
+				cond.notify_one();
+			}
+		}
+
+		template<typename Ready>
+		void park(std::atomic<int>& waiting, std::condition_variable& cond, Ready ready)
+		{
+			std::unique_lock<std::mutex> lk(mut);
+			waiting.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			cond.wait(lk, ready);
+			waiting.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		bool enqueue(T&& new_value)
+		{
+			std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+			for (;;) {
+				cell& c = buffer[pos & mask];
+				std::size_t seq = c.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+				if (diff == 0) {
+					if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						::new (static_cast<void*>(c.storage)) T(std::move(new_value));
+						c.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;		// full
+				} else {
+					pos = enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool dequeue(std::optional<T>& value)
+		{
+			std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+			for (;;) {
+				cell& c = buffer[pos & mask];
+				std::size_t seq = c.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+				if (diff == 0) {
+					if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						T* p = c.value();
+						value.emplace(std::move(*p));
+						p->~T();
+						c.sequence.store(pos + N, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;		// empty
+				} else {
+					pos = dequeue_pos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		std::optional<T> wait_and_pop_value()
+		{
+			std::optional<T> popped;
+			for (int spins = 0; !dequeue(popped); ++spins) {
+				if (spins < spin_limit)
+					std::this_thread::yield();
+				else
+					park(consumers_waiting, not_empty, [this]{ return has_item(); });
+			}
+			wake(producers_waiting, not_full);
+			return popped;
+		}
+
+	public:
+		BoundedThreadSafeQueue()
+			: enqueue_pos(0), dequeue_pos(0),
+			  consumers_waiting(0), producers_waiting(0)
+		{
+			for (std::size_t i = 0; i < N; ++i)
+				buffer[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		BoundedThreadSafeQueue(BoundedThreadSafeQueue const&) = delete;
+		BoundedThreadSafeQueue& operator=(BoundedThreadSafeQueue const&) = delete;
+
+		~BoundedThreadSafeQueue()
+		{
+			std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+			std::size_t end = enqueue_pos.load(std::memory_order_relaxed);
+			for (; pos != end; ++pos)
+				buffer[pos & mask].value()->~T();
+		}
+
+		static constexpr std::size_t capacity() { return N; }
+
+		// Returns false when the ring is full so the caller
+		// can apply backpressure instead of blocking.
+		bool try_push(T new_value)
+		{
+			if (!enqueue(std::move(new_value)))
+				return false;
+			wake(consumers_waiting, not_empty);
+			return true;
+		}
+
+		void push(T new_value)
+		{
+			for (int spins = 0; !enqueue(std::move(new_value)); ++spins) {
+				if (spins < spin_limit)
+					std::this_thread::yield();
+				else
+					park(producers_waiting, not_full, [this]{ return has_space(); });
+			}
+			wake(consumers_waiting, not_empty);
+		}
+
+		bool try_pop(T& value)
+		{
+			std::optional<T> popped;
+			if (!dequeue(popped))
+				return false;
+			wake(producers_waiting, not_full);
+			value = std::move(*popped);
+			return true;
+		}
+
+		// Allocates only when there is something to return.
+		std::shared_ptr<T> try_pop()
+		{
+			std::optional<T> popped;
+			if (!dequeue(popped))
+				return std::shared_ptr<T>();
+			wake(producers_waiting, not_full);
+			return std::make_shared<T>(std::move(*popped));
+		}
+
+		void wait_and_pop(T& value)
+		{
+			value = std::move(*wait_and_pop_value());
+		}
+
+		std::shared_ptr<T> wait_and_pop()
+		{
+			return std::make_shared<T>(std::move(*wait_and_pop_value()));
+		}
+
+		// Only a snapshot: another thread may change it
+		// before the caller acts on the answer.
+		bool empty() const
+		{
+			return !has_item();
+		}
+};
@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "NodePool.hpp"
+#include "WaitPolicy.hpp"
+
+/*
+	Relaxed concurrent priority queue (MultiQueue).
+
+	Instead of one heap behind one lock we keep several
+	small heaps, each with its own mutex:
+		- push tries to lock a few random heaps, pausing
+		  briefly between misses, and if they are all
+		  busy it blocks on the last one it picked.
+		- pop picks two random heaps, locks both (try_lock,
+		  so there is no lock-order deadlock) and takes the
+		  better of the two tops.
+
+	"Best of two" keeps the popped element close to the
+	true maximum: high-severity items overtake the
+	backlog, but two items of almost equal priority may
+	come out in either order. If every heap looks empty,
+	pop falls back to a full scan before reporting
+	failure.
+
+	`count` is a hint for consumers only. A push raises
+	it after the item is in a heap and a pop lowers it
+	after taking one, so it may briefly lag the heaps
+	(or dip below zero) but a consumer that sees it
+	positive will find the item. Pushes only touch the
+	wait mutex when a consumer is registered in
+	`sleepers`.
+
+	Pops go through a local std::optional, so T only has
+	to be movable; the shared_ptr pops allocate from the
+	NodePool once they actually have an element.
+
+	Compare follows std::priority_queue: with the default
+	std::less the largest element comes out first.
+*/
+template<typename T, typename Compare = std::less<T>>
+class ConcurrentPriorityQueue
+{
+	private:
+		static constexpr std::size_t cache_line = 64;
+		static constexpr int pick_attempts = 8;
+		static constexpr int push_attempts = 4;
+
+		struct alignas(cache_line) sub_heap
+		{
+			std::mutex m;
+			std::vector<T> heap;
+		};
+
+		Compare comp;
+		PoolAllocator<T> alloc;
+		std::size_t const heap_count;
+		std::unique_ptr<sub_heap[]> heaps;
+
+		alignas(cache_line) std::atomic<std::ptrdiff_t> count;
+		std::atomic<int> sleepers;
+		std::mutex wait_mut;
+		std::condition_variable data_cond;
+
+		static std::uint64_t next_random()
+		{
+			static thread_local std::uint64_t state =
+				std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		std::size_t random_heap()
+		{
+			return static_cast<std::size_t>(next_random() % heap_count);
+		}
+
+		void push_locked(sub_heap& h, T&& value)
+		{
+			h.heap.push_back(std::move(value));
+			std::push_heap(h.heap.begin(), h.heap.end(), comp);
+		}
+
+		T pop_locked(sub_heap& h)
+		{
+			std::pop_heap(h.heap.begin(), h.heap.end(), comp);
+			T res(std::move(h.heap.back()));
+			h.heap.pop_back();
+			return res;
+		}
+
+		// true if a's top should come out before b's.
+		bool better(sub_heap& a, sub_heap& b)
+		{
+			if (a.heap.empty())
+				return false;
+			if (b.heap.empty())
+				return true;
+			return comp(b.heap.front(), a.heap.front());
+		}
+
+		bool pop_best_of_two(std::optional<T>& value)
+		{
+			for (int attempt = 0; attempt < pick_attempts; ++attempt) {
+				std::size_t i = random_heap();
+				std::size_t j = random_heap();
+				if (i == j)
+					j = (i + 1) % heap_count;
+				std::unique_lock<std::mutex> li(heaps[i].m, std::try_to_lock);
+				if (!li.owns_lock())
+					continue;
+				std::unique_lock<std::mutex> lj(heaps[j].m, std::try_to_lock);
+				if (!lj.owns_lock())
+					continue;
+				sub_heap& best = better(heaps[j], heaps[i]) ? heaps[j] : heaps[i];
+				if (best.heap.empty())
+					continue;
+				value.emplace(pop_locked(best));
+				return true;
+			}
+			return false;
+		}
+
+		// Slow path: visit every heap so try_pop only fails
+		// when the queue really was empty during the scan.
+		bool pop_scan(std::optional<T>& value)
+		{
+			std::size_t const start = random_heap();
+			for (std::size_t k = 0; k < heap_count; ++k) {
+				sub_heap& h = heaps[(start + k) % heap_count];
+				std::lock_guard<std::mutex> lk(h.m);
+				if (!h.heap.empty()) {
+					value.emplace(pop_locked(h));
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool pop_any(std::optional<T>& value)
+		{
+			if (count.load(std::memory_order_acquire) <= 0)
+				return false;
+			if (!pop_best_of_two(value) && !pop_scan(value))
+				return false;
+			count.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		std::optional<T> wait_and_pop_value()
+		{
+			std::optional<T> popped;
+			while (!pop_any(popped)) {
+				std::unique_lock<std::mutex> lk(wait_mut);
+				sleepers.fetch_add(1, std::memory_order_relaxed);
+				data_cond.wait(lk, [this]{
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					return count.load(std::memory_order_relaxed) > 0;
+				});
+				sleepers.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return popped;
+		}
+
+	public:
+		// `heaps_per_thread` sub-heaps per hardware thread;
+		// two is the usual sweet spot for MultiQueues.
+		explicit ConcurrentPriorityQueue(std::size_t heaps_per_thread = 2,
+				Compare const& compare = Compare())
+			: comp(compare),
+			  heap_count(std::max<std::size_t>(2,
+				heaps_per_thread * std::max(1u, std::thread::hardware_concurrency()))),
+			  heaps(new sub_heap[heap_count]),
+			  count(0), sleepers(0)
+		{}
+
+		ConcurrentPriorityQueue(ConcurrentPriorityQueue const&) = delete;
+		ConcurrentPriorityQueue& operator=(ConcurrentPriorityQueue const&) = delete;
+
+		void push(T new_value)
+		{
+			{
+				sub_heap* h = &heaps[random_heap()];
+				std::unique_lock<std::mutex> lk(h->m, std::try_to_lock);
+				for (int attempt = 1; !lk.owns_lock(); ++attempt) {
+					h = &heaps[random_heap()];
+					if (attempt < push_attempts) {
+						cpu_relax();
+						lk = std::unique_lock<std::mutex>(h->m, std::try_to_lock);
+					} else {
+						lk = std::unique_lock<std::mutex>(h->m);
+					}
+				}
+				push_locked(*h, std::move(new_value));
+			}
+			count.fetch_add(1, std::memory_order_release);
+			// Pairs with the fence in wait_and_pop_value:
+			// either we see the sleeper, or it sees the new count.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleepers.load(std::memory_order_relaxed) > 0) {
+				std::lock_guard<std::mutex> lk(wait_mut);
+				data_cond.notify_one();
+			}
+		}
+
+		bool try_pop(T& value)
+		{
+			std::optional<T> popped;
+			if (!pop_any(popped))
+				return false;
+			value = std::move(*popped);
+			return true;
+		}
+
+		std::shared_ptr<T> try_pop()
+		{
+			std::optional<T> popped;
+			if (!pop_any(popped))
+				return std::shared_ptr<T>();
+			return std::allocate_shared<T>(alloc, std::move(*popped));
+		}
+
+		void wait_and_pop(T& value)
+		{
+			value = std::move(*wait_and_pop_value());
+		}
+
+		std::shared_ptr<T> wait_and_pop()
+		{
+			return std::allocate_shared<T>(alloc, std::move(*wait_and_pop_value()));
+		}
+
+		bool empty() const
+		{
+			return count.load(std::memory_order_acquire) <= 0;
+		}
+};
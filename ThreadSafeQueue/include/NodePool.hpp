@@ -0,0 +1,227 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/*
+	A tiny recycling allocator.
+
+	Freed blocks go onto a free list instead of back to
+	the heap, so once a queue has reached its working
+	size, push/pop cycles reuse the same memory and never
+	call malloc.
+
+	Blocks are sorted into power-of-two size classes from
+	16 to 1024 bytes (the shared_ptr control block +
+	value, deque chunks and maps); anything bigger falls
+	through to operator new.
+
+	Each thread keeps a private free list per class of at
+	most local_limit blocks, so allocating and freeing
+	normally touch nothing shared. Blocks freed beyond
+	that go onto a shared lock-free list per class, which
+	is only ever pushed to and emptied as a whole with
+	exchange(), so there is no ABA. A thread whose list
+	runs dry takes the shared one, keeps local_limit
+	blocks and puts the rest back. That way a consumer
+	thread's frees flow back to the producers.
+
+	There is one pool per process and it is never
+	destroyed, so memory from it may be freed at any
+	time, on any thread. That includes frees after the
+	calling thread's cache is gone, e.g. a queue with
+	static storage duration destroyed after main's
+	thread_locals: those go straight to the shared list,
+	and allocations at that point to operator new.
+*/
+class NodePool
+{
+	private:
+		static constexpr std::size_t min_shift = 4;
+		static constexpr std::size_t max_shift = 10;
+		static constexpr std::size_t class_count = max_shift - min_shift + 1;
+		static constexpr std::size_t local_limit = 256;
+
+		struct free_block { free_block* next; };
+
+		struct shared_list
+		{
+			std::atomic<free_block*> head{nullptr};
+
+			void push(free_block* b)
+			{
+				b->next = head.load(std::memory_order_relaxed);
+				while (!head.compare_exchange_weak(b->next, b,
+						std::memory_order_release, std::memory_order_relaxed))
+					;
+			}
+
+			// Splice a null-terminated chain back on; one CAS
+			// unless somebody pushed since we emptied the list.
+			void push_chain(free_block* first)
+			{
+				free_block* expected = nullptr;
+				if (head.compare_exchange_strong(expected, first,
+						std::memory_order_release, std::memory_order_relaxed))
+					return;
+				free_block* last = first;
+				while (last->next)
+					last = last->next;
+				last->next = expected;
+				while (!head.compare_exchange_weak(last->next, first,
+						std::memory_order_release, std::memory_order_relaxed))
+					;
+			}
+		};
+
+		struct local_list
+		{
+			free_block* head = nullptr;
+			std::size_t count = 0;
+		};
+
+		// A thread's lists go back to the pool when it exits.
+		struct thread_cache
+		{
+			local_list lists[class_count];
+
+			~thread_cache()
+			{
+				for (std::size_t c = 0; c < class_count; ++c) {
+					if (lists[c].head)
+						instance().shared[c].push_chain(lists[c].head);
+				}
+				cache_gone() = true;
+			}
+		};
+
+		shared_list shared[class_count];
+
+		NodePool() {}
+
+		// Trivially destructible, so still readable after
+		// the thread's cache has been destroyed.
+		static bool& cache_gone()
+		{
+			thread_local bool gone = false;
+			return gone;
+		}
+
+		static thread_cache& local()
+		{
+			thread_local thread_cache cache;
+			return cache;
+		}
+
+		// Size class for `bytes`, or class_count if too big.
+		static std::size_t class_for(std::size_t bytes)
+		{
+			std::size_t c = 0;
+			while (c < class_count && (std::size_t(1) << (min_shift + c)) < bytes)
+				++c;
+			return c;
+		}
+
+	public:
+		NodePool(NodePool const&) = delete;
+		NodePool& operator=(NodePool const&) = delete;
+
+		static NodePool& instance()
+		{
+			static NodePool* const pool = new NodePool;
+			return *pool;
+		}
+
+		void* allocate(std::size_t bytes)
+		{
+			std::size_t const c = class_for(bytes);
+			if (c == class_count)
+				return ::operator new(bytes);
+			if (cache_gone())
+				return ::operator new(std::size_t(1) << (min_shift + c));
+			local_list& l = local().lists[c];
+			if (!l.head) {
+				l.head = shared[c].head.exchange(nullptr, std::memory_order_acquire);
+				free_block* last = l.head;
+				l.count = last ? 1 : 0;
+				while (last && last->next && l.count < local_limit) {
+					last = last->next;
+					++l.count;
+				}
+				if (last && last->next) {
+					free_block* const rest = last->next;
+					last->next = nullptr;
+					shared[c].push_chain(rest);
+				}
+			}
+			if (free_block* b = l.head) {
+				l.head = b->next;
+				--l.count;
+				return b;
+			}
+			return ::operator new(std::size_t(1) << (min_shift + c));
+		}
+
+		void deallocate(void* p, std::size_t bytes) noexcept
+		{
+			std::size_t const c = class_for(bytes);
+			if (c == class_count) {
+				::operator delete(p);
+				return;
+			}
+			free_block* const b = static_cast<free_block*>(p);
+			if (cache_gone()) {
+				shared[c].push(b);
+				return;
+			}
+			local_list& l = local().lists[c];
+			if (l.count < local_limit) {
+				b->next = l.head;
+				l.head = b;
+				++l.count;
+			} else {
+				shared[c].push(b);
+			}
+		}
+};
+
+/*
+	std-compatible allocator front end. It is a single
+	raw pointer to the process-wide pool, so copying it
+	(every allocate_shared control block holds one) costs
+	nothing, and since the pool outlives everything a
+	shared_ptr handed out by a pop can safely outlive the
+	queue that produced it.
+*/
+template<typename T>
+class PoolAllocator
+{
+	template<typename U> friend class PoolAllocator;
+
+	private:
+		NodePool* pool;
+
+	public:
+		using value_type = T;
+
+		PoolAllocator() noexcept : pool(&NodePool::instance()) {}
+		template<typename U>
+		PoolAllocator(PoolAllocator<U> const& other) noexcept : pool(other.pool) {}
+
+		T* allocate(std::size_t n)
+		{
+			static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+					"PoolAllocator does not support over-aligned types");
+			return static_cast<T*>(pool->allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T* p, std::size_t n) noexcept
+		{
+			pool->deallocate(p, n * sizeof(T));
+		}
+
+		template<typename U>
+		bool operator==(PoolAllocator<U> const& other) const noexcept { return pool == other.pool; }
+		template<typename U>
+		bool operator!=(PoolAllocator<U> const& other) const noexcept { return pool != other.pool; }
+};
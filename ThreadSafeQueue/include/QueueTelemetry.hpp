@@ -0,0 +1,252 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/*
+	Opt-in queue instrumentation.
+
+	ThreadSafeQueue takes a Telemetry policy as its third
+	template parameter. NoTelemetry (the default) has no
+	state and every hook is an empty inline function, and
+	the queue guards the extra work behind
+	`if constexpr (Telemetry::enabled)`, so a queue built
+	without telemetry compiles to exactly what it was.
+
+	QueueTelemetry records
+		- current and high-water depth,
+		- per-item sojourn time (push to pop),
+		- time consumers spent blocked in wait_and_pop,
+		- how often a producer found the mutex taken,
+	into relaxed atomic counters. The counters are split
+	into shards, one per hardware thread (rounded up to a
+	power of two, at most 64), and each queue allocates
+	its own. A thread records into shard
+	`thread index % shards`, so with more threads than
+	shards some of them share one; the counters are
+	atomic, so that only costs locality. Nothing on the
+	hot path takes a lock, and snapshot() sums the shards
+	into a QueueStats value.
+*/
+
+struct NoTelemetry
+{
+	static constexpr bool enabled = false;
+	struct stamp {};
+
+	static stamp now() { return stamp(); }
+	void on_push(std::size_t) {}
+	void on_pop(std::size_t, stamp) {}
+	void on_contention() {}
+	void on_blocked(std::chrono::nanoseconds) {}
+};
+
+/*
+	A queued value plus the time it was pushed. With an
+	empty stamp type (NoTelemetry) the empty base makes
+	this exactly as large as the value itself.
+*/
+template<typename V, typename Stamp, bool = std::is_empty<Stamp>::value>
+struct StampedValue
+{
+	V value;
+	Stamp pushed_at;
+
+	StampedValue(V v, Stamp s) : value(std::move(v)), pushed_at(s) {}
+	Stamp stamp() const { return pushed_at; }
+};
+
+template<typename V, typename Stamp>
+struct StampedValue<V, Stamp, true> : private Stamp
+{
+	V value;
+
+	StampedValue(V v, Stamp) : value(std::move(v)) {}
+	Stamp stamp() const { return Stamp(); }
+};
+
+/*
+	log2 histogram of nanosecond durations: bucket i counts
+	samples in [2^i, 2^(i+1)) ns, bucket 0 also takes 0.
+*/
+struct LatencyHistogram
+{
+	static constexpr std::size_t bucket_count = 48;
+	std::array<std::uint64_t, bucket_count> buckets{};
+
+	std::uint64_t total() const
+	{
+		std::uint64_t n = 0;
+		for (std::uint64_t b : buckets)
+			n += b;
+		return n;
+	}
+
+	// Upper bound (in ns) of the bucket holding quantile q.
+	std::uint64_t percentile(double q) const
+	{
+		std::uint64_t const n = total();
+		if (n == 0)
+			return 0;
+		std::uint64_t const target = static_cast<std::uint64_t>(q * static_cast<double>(n - 1)) + 1;
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucket_count; ++i) {
+			seen += buckets[i];
+			if (seen >= target)
+				return (std::uint64_t(1) << (i + 1)) - 1;
+		}
+		return ~std::uint64_t(0);
+	}
+
+	static std::size_t bucket_for(std::uint64_t ns)
+	{
+		std::size_t i = 0;
+		while (ns > 1 && i + 1 < bucket_count) {
+			ns >>= 1;
+			++i;
+		}
+		return i;
+	}
+};
+
+struct QueueStats
+{
+	std::size_t depth = 0;
+	std::size_t high_water_depth = 0;
+	std::uint64_t pushes = 0;
+	std::uint64_t pops = 0;
+	std::uint64_t producer_contention = 0;
+	LatencyHistogram sojourn;
+	LatencyHistogram blocked;
+};
+
+// Small dense id per thread, used to pick a telemetry shard.
+inline std::size_t telemetry_thread_index()
+{
+	static std::atomic<std::size_t> next{0};
+	static thread_local std::size_t const index = next.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+class QueueTelemetry
+{
+	public:
+		static constexpr bool enabled = true;
+		using clock = std::chrono::steady_clock;
+		using stamp = clock::time_point;
+
+	private:
+		static constexpr std::size_t max_shards = 64;
+		static constexpr std::size_t cache_line = 64;
+
+		struct alignas(cache_line) shard
+		{
+			std::atomic<std::uint64_t> pushes{0};
+			std::atomic<std::uint64_t> pops{0};
+			std::atomic<std::uint64_t> contention{0};
+			std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> sojourn{};
+			std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> blocked{};
+		};
+
+		std::size_t const shard_mask;
+		std::unique_ptr<shard[]> shards;
+		alignas(cache_line) std::atomic<std::size_t> depth{0};
+		std::atomic<std::size_t> high_water{0};
+
+		static std::size_t shards_for_machine()
+		{
+			std::size_t const cpus = std::thread::hardware_concurrency();
+			std::size_t n = 1;
+			while (n < cpus && n < max_shards)
+				n <<= 1;
+			return n;
+		}
+
+		shard& local()
+		{
+			return shards[telemetry_thread_index() & shard_mask];
+		}
+
+		static void bump(std::atomic<std::uint64_t>& c)
+		{
+			c.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		static void record(std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count>& h,
+				std::chrono::nanoseconds d)
+		{
+			std::uint64_t const ns = d.count() > 0 ? static_cast<std::uint64_t>(d.count()) : 0;
+			bump(h[LatencyHistogram::bucket_for(ns)]);
+		}
+
+		static void sum_into(LatencyHistogram& out,
+				std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> const& h)
+		{
+			for (std::size_t i = 0; i < LatencyHistogram::bucket_count; ++i)
+				out.buckets[i] += h[i].load(std::memory_order_relaxed);
+		}
+
+		void set_depth(std::size_t d)
+		{
+			depth.store(d, std::memory_order_relaxed);
+			std::size_t hw = high_water.load(std::memory_order_relaxed);
+			while (d > hw && !high_water.compare_exchange_weak(hw, d, std::memory_order_relaxed))
+				;
+		}
+
+	public:
+		QueueTelemetry()
+			: shard_mask(shards_for_machine() - 1),
+			  shards(new shard[shard_mask + 1])
+		{}
+
+		static stamp now() { return clock::now(); }
+
+		void on_push(std::size_t new_depth)
+		{
+			bump(local().pushes);
+			set_depth(new_depth);
+		}
+
+		void on_pop(std::size_t new_depth, stamp pushed_at)
+		{
+			shard& s = local();
+			bump(s.pops);
+			record(s.sojourn, clock::now() - pushed_at);
+			set_depth(new_depth);
+		}
+
+		void on_contention()
+		{
+			bump(local().contention);
+		}
+
+		void on_blocked(std::chrono::nanoseconds d)
+		{
+			record(local().blocked, d);
+		}
+
+		// Counters keep moving while we read them, so the
+		// result is a close approximation, not an atomic cut.
+		QueueStats snapshot() const
+		{
+			QueueStats s;
+			s.depth = depth.load(std::memory_order_relaxed);
+			s.high_water_depth = high_water.load(std::memory_order_relaxed);
+			for (std::size_t i = 0; i <= shard_mask; ++i) {
+				shard const& sh = shards[i];
+				s.pushes += sh.pushes.load(std::memory_order_relaxed);
+				s.pops += sh.pops.load(std::memory_order_relaxed);
+				s.producer_contention += sh.contention.load(std::memory_order_relaxed);
+				sum_into(s.sojourn, sh.sojourn);
+				sum_into(s.blocked, sh.blocked);
+			}
+			return s;
+		}
+};
@@ -0,0 +1,195 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <condition_variable>
+#include "NodePool.hpp"
+
+/*
+	Multi-lane queue: one independently locked FIFO lane
+	per producer (or per CPU).
+
+	A producer pushes into its home lane, so 32 sensor
+	threads no longer bounce a single mutex cache line
+	between all cores. A consumer first tries its own
+	home lane and, if that is empty, steals round-robin
+	from the others.
+
+	Nothing on the push/pop path is shared between
+	lanes: each lane publishes its own size (written
+	under its lock, on its own cache line), which lets
+	consumers skip empty lanes without locking them, and
+	a push only takes the wait mutex when a consumer has
+	announced it is about to sleep.
+
+	Ordering is FIFO per lane only; items pushed to
+	different lanes may be popped in any order.
+
+	A thread's home lane is its thread index (handed out
+	once per thread, process-wide) modulo the lane count,
+	so a thread that pops from one queue and pushes to
+	another keeps a stable lane in both. Pass an explicit
+	lane to push/try_pop if you want a fixed mapping.
+
+	Pops go through a local std::optional, so T only has
+	to be movable; the shared_ptr pops allocate from the
+	NodePool once they actually have an element.
+*/
+template<typename T>
+class ShardedThreadSafeQueue
+{
+	private:
+		static constexpr std::size_t cache_line = 64;
+
+		struct alignas(cache_line) lane
+		{
+			std::mutex m;
+			std::atomic<std::size_t> size{0};
+			std::deque<T> items;
+		};
+
+		std::size_t const num_lanes;
+		PoolAllocator<T> alloc;
+		std::unique_ptr<lane[]> lanes;
+
+		alignas(cache_line) std::atomic<int> sleepers;
+		std::mutex wait_mut;
+		std::condition_variable data_cond;
+
+		static std::size_t thread_index()
+		{
+			static std::atomic<std::size_t> next{0};
+			thread_local std::size_t const index = next.fetch_add(1, std::memory_order_relaxed);
+			return index;
+		}
+
+		std::size_t home_lane() const
+		{
+			return thread_index() % num_lanes;
+		}
+
+		bool has_items() const
+		{
+			for (std::size_t i = 0; i < num_lanes; ++i) {
+				if (lanes[i].size.load(std::memory_order_relaxed) != 0)
+					return true;
+			}
+			return false;
+		}
+
+		bool pop_lane(lane& l, std::optional<T>& value)
+		{
+			if (l.size.load(std::memory_order_relaxed) == 0)
+				return false;
+			std::lock_guard<std::mutex> lk(l.m);
+			if (l.items.empty())
+				return false;
+			value.emplace(std::move(l.items.front()));
+			l.items.pop_front();
+			l.size.store(l.items.size(), std::memory_order_relaxed);
+			return true;
+		}
+
+		bool pop_from(std::size_t home, std::optional<T>& value)
+		{
+			for (std::size_t k = 0; k < num_lanes; ++k) {
+				if (pop_lane(lanes[(home + k) % num_lanes], value))
+					return true;
+			}
+			return false;
+		}
+
+		std::optional<T> wait_and_pop_value()
+		{
+			std::size_t const home = home_lane();
+			std::optional<T> popped;
+			while (!pop_from(home, popped)) {
+				std::unique_lock<std::mutex> lk(wait_mut);
+				sleepers.fetch_add(1, std::memory_order_relaxed);
+				data_cond.wait(lk, [this]{
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					return has_items();
+				});
+				sleepers.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return popped;
+		}
+
+	public:
+		explicit ShardedThreadSafeQueue(
+				std::size_t lanes_ = std::max(1u, std::thread::hardware_concurrency()))
+			: num_lanes(lanes_ ? lanes_ : 1),
+			  lanes(new lane[num_lanes]),
+			  sleepers(0)
+		{}
+
+		ShardedThreadSafeQueue(ShardedThreadSafeQueue const&) = delete;
+		ShardedThreadSafeQueue& operator=(ShardedThreadSafeQueue const&) = delete;
+
+		std::size_t lane_count() const { return num_lanes; }
+
+		void push(std::size_t lane_index, T new_value)
+		{
+			{
+				lane& l = lanes[lane_index % num_lanes];
+				std::lock_guard<std::mutex> lk(l.m);
+				l.items.push_back(std::move(new_value));
+				l.size.store(l.items.size(), std::memory_order_relaxed);
+			}
+			// Pairs with the fence in wait_and_pop_value:
+			// either we see the sleeper, or it sees our lane's size.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleepers.load(std::memory_order_relaxed) > 0) {
+				std::lock_guard<std::mutex> lk(wait_mut);
+				data_cond.notify_one();
+			}
+		}
+
+		void push(T new_value)
+		{
+			push(home_lane(), std::move(new_value));
+		}
+
+		bool try_pop(std::size_t lane_index, T& value)
+		{
+			std::optional<T> popped;
+			if (!pop_from(lane_index % num_lanes, popped))
+				return false;
+			value = std::move(*popped);
+			return true;
+		}
+
+		bool try_pop(T& value)
+		{
+			return try_pop(home_lane(), value);
+		}
+
+		std::shared_ptr<T> try_pop()
+		{
+			std::optional<T> popped;
+			if (!pop_from(home_lane(), popped))
+				return std::shared_ptr<T>();
+			return std::allocate_shared<T>(alloc, std::move(*popped));
+		}
+
+		void wait_and_pop(T& value)
+		{
+			value = std::move(*wait_and_pop_value());
+		}
+
+		std::shared_ptr<T> wait_and_pop()
+		{
+			return std::allocate_shared<T>(alloc, std::move(*wait_and_pop_value()));
+		}
+
+		// Only a snapshot: lanes are looked at one by one.
+		bool empty() const
+		{
+			return !has_items();
+		}
+};
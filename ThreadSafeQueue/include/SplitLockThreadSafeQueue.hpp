@@ -0,0 +1,173 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+/*
+	Unbounded queue with separate head and tail locks.
+
+	The list always ends in a dummy node, so head and
+	tail never point at the same real element: push
+	only touches `tail` (under tail_mutex) and the pops
+	only touch `head` (under head_mutex). Producers and
+	consumers therefore stop fighting over one mutex.
+
+	The value and the new dummy node are allocated
+	before the tail lock is taken, keeping the critical
+	section down to two pointer writes.
+
+	Same public surface as ThreadSafeQueue<T>, copy
+	constructor included, so the two are drop-in
+	replacements for each other.
+*/
+template<typename T>
+class SplitLockThreadSafeQueue
+{
+	private:
+		struct node
+		{
+			std::shared_ptr<T> data;
+			std::unique_ptr<node> next;
+		};
+
+		mutable std::mutex head_mutex;
+		std::unique_ptr<node> head;
+		mutable std::mutex tail_mutex;
+		node* tail;
+		std::condition_variable data_cond;
+		std::atomic<int> waiters;
+
+		node* get_tail() const
+		{
+			std::lock_guard<std::mutex> tail_lock(tail_mutex);
+			return tail;
+		}
+
+		std::unique_ptr<node> pop_head()
+		{
+			std::unique_ptr<node> old_head = std::move(head);
+			head = std::move(old_head->next);
+			return old_head;
+		}
+
+		std::unique_lock<std::mutex> wait_for_data()
+		{
+			std::unique_lock<std::mutex> head_lock(head_mutex);
+			if (head.get() == get_tail()) {
+				waiters.fetch_add(1);
+				data_cond.wait(head_lock, [&]{ return head.get() != get_tail(); });
+				waiters.fetch_sub(1);
+			}
+			return head_lock;
+		}
+
+		std::unique_ptr<node> wait_pop_head()
+		{
+			std::unique_lock<std::mutex> head_lock(wait_for_data());
+			return pop_head();
+		}
+
+		std::unique_ptr<node> wait_pop_head(T& value)
+		{
+			std::unique_lock<std::mutex> head_lock(wait_for_data());
+			value = std::move(*head->data);
+			return pop_head();
+		}
+
+		std::unique_ptr<node> try_pop_head()
+		{
+			std::lock_guard<std::mutex> head_lock(head_mutex);
+			if (head.get() == get_tail())
+				return std::unique_ptr<node>();
+			return pop_head();
+		}
+
+		std::unique_ptr<node> try_pop_head(T& value)
+		{
+			std::lock_guard<std::mutex> head_lock(head_mutex);
+			if (head.get() == get_tail())
+				return std::unique_ptr<node>();
+			value = std::move(*head->data);
+			return pop_head();
+		}
+
+	public:
+		SplitLockThreadSafeQueue()
+			: head(new node), tail(head.get()), waiters(0)
+		{}
+
+		// Takes head_mutex then tail_mutex, the same order
+		// the pops use, and copies every value into a fresh
+		// dummy-terminated list.
+		SplitLockThreadSafeQueue(SplitLockThreadSafeQueue const& other)
+			: head(new node), tail(head.get()), waiters(0)
+		{
+			std::lock_guard<std::mutex> head_lock(other.head_mutex);
+			std::lock_guard<std::mutex> tail_lock(other.tail_mutex);
+			for (node const* n = other.head.get(); n != other.tail; n = n->next.get()) {
+				tail->data = std::make_shared<T>(*n->data);
+				tail->next.reset(new node);
+				tail = tail->next.get();
+			}
+		}
+
+		SplitLockThreadSafeQueue& operator=(SplitLockThreadSafeQueue const&) = delete;
+
+		~SplitLockThreadSafeQueue()
+		{
+			// Unlink iteratively so a long backlog can't
+			// blow the stack through recursive unique_ptr dtors.
+			while (head)
+				head = std::move(head->next);
+		}
+
+		void push(T new_value)
+		{
+			std::shared_ptr<T> new_data(std::make_shared<T>(std::move(new_value)));
+			std::unique_ptr<node> p(new node);
+			{
+				std::lock_guard<std::mutex> tail_lock(tail_mutex);
+				tail->data = new_data;
+				node* const new_tail = p.get();
+				tail->next = std::move(p);
+				tail = new_tail;
+			}
+			// Consumers register in `waiters` under head_mutex
+			// before sleeping, so the head lock is only taken
+			// here when somebody is actually parked.
+			if (waiters.load() > 0) {
+				std::lock_guard<std::mutex> head_lock(head_mutex);
+				data_cond.notify_one();
+			}
+		}
+
+		void wait_and_pop(T& value)
+		{
+			std::unique_ptr<node> const old_head = wait_pop_head(value);
+		}
+
+		std::shared_ptr<T> wait_and_pop()
+		{
+			std::unique_ptr<node> const old_head = wait_pop_head();
+			return old_head->data;
+		}
+
+		bool try_pop(T& value)
+		{
+			std::unique_ptr<node> const old_head = try_pop_head(value);
+			return static_cast<bool>(old_head);
+		}
+
+		std::shared_ptr<T> try_pop()
+		{
+			std::unique_ptr<node> old_head = try_pop_head();
+			return old_head ? old_head->data : std::shared_ptr<T>();
+		}
+
+		bool empty() const
+		{
+			std::lock_guard<std::mutex> head_lock(head_mutex);
+			return head.get() == get_tail();
+		}
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <condition_variable>
+#include "WaitPolicy.hpp"
+
+/*
+	Single-producer / single-consumer ring.
+
+	With exactly one thread on each end there is nothing
+	to arbitrate, so push and pop are wait-free: the
+	producer owns `tail`, the consumer owns `head`, and
+	each side publishes its index with a release store
+	that the other side reads with acquire.
+
+	Each side also keeps a private copy of the other
+	side's index (`cached_head`, `cached_tail`) and only
+	re-reads the shared one when the cached value says
+	the ring is full/empty, which keeps the cross-core
+	cache traffic to roughly one line transfer per batch.
+
+	Capacity is rounded up to a power of two.
+
+	By default (Parking = false) push / wait_and_pop
+	spin with a pause hint and then yield, and push/pop
+	do nothing but the two index updates: the pinned-core
+	handoff this queue is for. With Parking = true they
+	sleep on a condition variable once spinning gives
+	up, which frees the core when a side may idle for
+	long, at the cost of a full fence per operation to
+	check whether the other side is asleep.
+*/
+template<typename T, bool Parking = false>
+class SpscQueue
+{
+	private:
+		static constexpr std::size_t cache_line = 64;
+		static constexpr int spin_limit = 128;
+
+		struct slot
+		{
+			alignas(T) unsigned char storage[sizeof(T)];
+			T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+		};
+
+		std::size_t const mask;
+		std::unique_ptr<slot[]> buffer;
+
+		// consumer-owned line
+		alignas(cache_line) std::atomic<std::size_t> head;
+		std::size_t cached_tail;
+
+		// producer-owned line
+		alignas(cache_line) std::atomic<std::size_t> tail;
+		std::size_t cached_head;
+
+		alignas(cache_line) std::atomic<bool> consumer_parked;
+		std::atomic<bool> producer_parked;
+		std::mutex mut;
+		std::condition_variable cond;
+
+		static std::size_t round_up(std::size_t n)
+		{
+			std::size_t cap = 2;
+			while (cap < n)
+				cap <<= 1;
+			return cap;
+		}
+
+		void wake(std::atomic<bool>& parked)
+		{
+			if (!Parking)
+				return;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (parked.load(std::memory_order_relaxed)) {
+				std::lock_guard<std::mutex> lk(mut);
+				cond.notify_all();
+			}
+		}
+
+		template<typename Ready>
+		void park(std::atomic<bool>& parked, Ready ready)
+		{
+			std::unique_lock<std::mutex> lk(mut);
+			parked.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			cond.wait(lk, ready);
+			parked.store(false, std::memory_order_relaxed);
+		}
+
+		template<typename Try, typename Ready>
+		void wait_until_done(std::atomic<bool>& parked, Try attempt, Ready ready)
+		{
+			for (int spins = 0; !attempt(); ++spins) {
+				if (spins < spin_limit) {
+					cpu_relax();
+					continue;
+				}
+				if (Parking)
+					park(parked, ready);
+				else
+					std::this_thread::yield();
+			}
+		}
+
+	public:
+		explicit SpscQueue(std::size_t capacity)
+			: mask(round_up(capacity) - 1),
+			  buffer(new slot[mask + 1]),
+			  head(0), cached_tail(0),
+			  tail(0), cached_head(0),
+			  consumer_parked(false), producer_parked(false)
+		{}
+
+		SpscQueue(SpscQueue const&) = delete;
+		SpscQueue& operator=(SpscQueue const&) = delete;
+
+		~SpscQueue()
+		{
+			std::size_t h = head.load(std::memory_order_relaxed);
+			std::size_t t = tail.load(std::memory_order_relaxed);
+			for (; h != t; ++h)
+				buffer[h & mask].value()->~T();
+		}
+
+		std::size_t capacity() const { return mask + 1; }
+
+		// Producer side only.
+		template<typename... Args>
+		bool try_emplace(Args&&... args)
+		{
+			std::size_t const t = tail.load(std::memory_order_relaxed);
+			if (t - cached_head > mask) {
+				cached_head = head.load(std::memory_order_acquire);
+				if (t - cached_head > mask)
+					return false;
+			}
+			::new (static_cast<void*>(buffer[t & mask].storage)) T(std::forward<Args>(args)...);
+			tail.store(t + 1, std::memory_order_release);
+			wake(consumer_parked);
+			return true;
+		}
+
+		bool try_push(T new_value)
+		{
+			return try_emplace(std::move(new_value));
+		}
+
+		void push(T new_value)
+		{
+			wait_until_done(producer_parked,
+				[&]{ return try_emplace(std::move(new_value)); },
+				[this]{ return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) <= mask; });
+		}
+
+		// Consumer side only.
+		bool try_pop(T& value)
+		{
+			std::size_t const h = head.load(std::memory_order_relaxed);
+			if (h == cached_tail) {
+				cached_tail = tail.load(std::memory_order_acquire);
+				if (h == cached_tail)
+					return false;
+			}
+			T* p = buffer[h & mask].value();
+			value = std::move(*p);
+			p->~T();
+			head.store(h + 1, std::memory_order_release);
+			wake(producer_parked);
+			return true;
+		}
+
+		void wait_and_pop(T& value)
+		{
+			wait_until_done(consumer_parked,
+				[&]{ return try_pop(value); },
+				[this]{ return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed); });
+		}
+
+		// Only a snapshot when called from the producer.
+		bool empty() const
+		{
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+};
@@ -1,42 +1,244 @@
-#include <queue>
+#pragma once
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <chrono>
+#include <cstddef>
 #include <condition_variable>
+#include <vector>
+#include "NodePool.hpp"
+#include "WaitPolicy.hpp"
+#include "QueueTelemetry.hpp"
 
-template<typename T>
+/*
+	Values live behind a shared_ptr that is created at
+	push time from a recycled NodePool, so:
+		- the shared_ptr pops hand out the stored pointer
+		  instead of allocating a fresh copy,
+		- the T& pops move out of it, which makes
+		  move-only payloads (std::packaged_task,
+		  std::unique_ptr) work,
+		- in steady state neither push nor pop mallocs.
+
+	WaitPolicy (see WaitPolicy.hpp) picks how a consumer
+	waits for an empty queue to fill: BlockingWait goes
+	straight to the condition variable, SpinThenBlock<N>
+	and YieldThenBlock<N> poll a lock-free size hint
+	first and only sleep if nothing turns up.
+
+	Telemetry (see QueueTelemetry.hpp) is NoTelemetry by
+	default; pass QueueTelemetry to record depth,
+	sojourn time, blocked time and producer contention,
+	and read them back with snapshot().
+*/
+template<typename T, typename WaitPolicy = BlockingWait, typename Telemetry = NoTelemetry>
 class ThreadSafeQueue
 {
 	private:
-		mutable std::mutext mut;
-		std::queue<T> data_queue;
+		using value_ptr = std::shared_ptr<T>;
+		using entry = StampedValue<value_ptr, typename Telemetry::stamp>;
+		using allocator = PoolAllocator<entry>;
+
+		mutable std::mutex mut;
+		allocator alloc;
+		std::deque<entry, allocator> data_queue;
+		Telemetry telemetry;
 		std::condition_variable data_cond;
+		std::size_t waiting_consumers = 0;
+		// Mirrors data_queue.size(); written under `mut`, read
+		// without it by the spinning phase of the wait policy.
+		std::atomic<std::size_t> size_hint{0};
+
+		void update_size_hint()
+		{
+			size_hint.store(data_queue.size(), std::memory_order_relaxed);
+		}
+
+		std::unique_lock<std::mutex> lock_for_push()
+		{
+			if constexpr (Telemetry::enabled) {
+				std::unique_lock<std::mutex> lk(mut, std::try_to_lock);
+				if (!lk.owns_lock()) {
+					telemetry.on_contention();
+					lk.lock();
+				}
+				return lk;
+			} else {
+				return std::unique_lock<std::mutex>(mut);
+			}
+		}
+
+		void push_back(value_ptr data)
+		{
+			data_queue.emplace_back(std::move(data), Telemetry::now());
+			telemetry.on_push(data_queue.size());
+		}
+
+		value_ptr pop_front()
+		{
+			entry& e = data_queue.front();
+			value_ptr res(std::move(e.value));
+			auto const pushed_at = e.stamp();
+			data_queue.pop_front();
+			update_size_hint();
+			telemetry.on_pop(data_queue.size(), pushed_at);
+			return res;
+		}
+
+		template<typename Wait>
+		void blocking_wait(Wait wait)
+		{
+			if constexpr (Telemetry::enabled) {
+				auto const start = std::chrono::steady_clock::now();
+				wait();
+				telemetry.on_blocked(std::chrono::steady_clock::now() - start);
+			} else {
+				wait();
+			}
+		}
+
+		std::unique_lock<std::mutex> wait_for_data()
+		{
+			WaitPolicy::spin([this]{ return size_hint.load(std::memory_order_relaxed) != 0; });
+			std::unique_lock<std::mutex> lk(mut);
+			if (data_queue.empty()) {
+				++waiting_consumers;
+				blocking_wait([&]{ data_cond.wait(lk, [this]{ return !data_queue.empty(); }); });
+				--waiting_consumers;
+			}
+			return lk;
+		}
+
+		// Returns an unlocked lock on timeout.
+		template<typename Clock, typename Duration>
+		std::unique_lock<std::mutex> wait_for_data_until(
+				std::chrono::time_point<Clock, Duration> const& deadline)
+		{
+			WaitPolicy::spin([this]{ return size_hint.load(std::memory_order_relaxed) != 0; });
+			std::unique_lock<std::mutex> lk(mut);
+			if (data_queue.empty()) {
+				++waiting_consumers;
+				bool ready = false;
+				blocking_wait([&]{ ready = data_cond.wait_until(lk, deadline, [this]{ return !data_queue.empty(); }); });
+				--waiting_consumers;
+				if (!ready)
+					lk.unlock();
+			}
+			return lk;
+		}
+
+		// Wake as many consumers as there are new items,
+		// but never more than are actually waiting.
+		void notify_for(std::size_t count, std::size_t waiting)
+		{
+			if (count >= waiting) {
+				if (waiting > 0)
+					data_cond.notify_all();
+				return;
+			}
+			while (count--)
+				data_cond.notify_one();
+		}
+
+		template<typename OutputIt>
+		std::size_t drain(OutputIt& out, std::size_t max_n)
+		{
+			std::size_t n = 0;
+			for (; n < max_n && !data_queue.empty(); ++n) {
+				*out = std::move(*pop_front());
+				++out;
+			}
+			return n;
+		}
+
 	public:
-		ThreadSafeQueue() {}
-		ThreadSafeQueue(ThreadSafeQueue const& other)
+		ThreadSafeQueue() : data_queue(alloc) {}
+		ThreadSafeQueue(ThreadSafeQueue const& other) : data_queue(alloc)
 		{
-			std::lock_guard<std::mutex> lk(other);
-			data_queue = other.data_queue;
+			std::lock_guard<std::mutex> lk(other.mut);
+			for (entry const& e : other.data_queue)
+				push_back(std::allocate_shared<T>(alloc, *e.value));
+			update_size_hint();
 		}
 
 		void push(T new_value) {
-			std::lock_guard<std::mutex> lk(mut);
-			data_queue.push(new_value);
-			data_queue.notify_one();
+			emplace(std::move(new_value));
+		}
+
+		// The value is constructed before the lock is taken;
+		// the critical section is just the pointer push.
+		template<typename... Args>
+		void emplace(Args&&... args) {
+			value_ptr data(std::allocate_shared<T>(alloc, std::forward<Args>(args)...));
+			std::unique_lock<std::mutex> lk(lock_for_push());
+			push_back(std::move(data));
+			update_size_hint();
+			if (waiting_consumers > 0)
+				data_cond.notify_one();
+		}
+
+		/*
+			Batch push: the values are built first, as in
+			emplace, then pushed under one lock acquisition
+			for the whole range; wakes up to one consumer
+			per item.
+		*/
+		template<typename InputIt>
+		void push_range(InputIt first, InputIt last) {
+			std::vector<value_ptr, PoolAllocator<value_ptr>> staged(alloc);
+			for (; first != last; ++first)
+				staged.push_back(std::allocate_shared<T>(alloc, *first));
+			std::size_t waiting;
+			{
+				std::unique_lock<std::mutex> lk(lock_for_push());
+				for (value_ptr& data : staged)
+					push_back(std::move(data));
+				update_size_hint();
+				waiting = waiting_consumers;
+			}
+			notify_for(staged.size(), waiting);
 		}
 
 		void wait_and_pop(T& value) {
-			std::unique_lock<std::mutex> lk(mut);
-			data_cond.wait(lk, []{ return !data_queue.empty(); });
-			value = data_queue.front();
-			data_queue.pop();
+			std::unique_lock<std::mutex> lk(wait_for_data());
+			value = std::move(*pop_front());
 		}
 
 		std::shared_ptr<T> wait_and_pop() {
-			std::unique_lock<std::mutex> lk(mut);
-			data_cond.wait(lk, []{return !data_queue.empty(); });
-			std::shared_ptr<T> res(std::make_ptr<T>(data_queue.front()));
-			data_queue.pop();
-			return res;
+			std::unique_lock<std::mutex> lk(wait_for_data());
+			return pop_front();
+		}
+
+		/*
+			Deadline variants: return false / an empty
+			shared_ptr if nothing arrived in time.
+		*/
+		template<typename Clock, typename Duration>
+		bool wait_and_pop_until(T& value, std::chrono::time_point<Clock, Duration> const& deadline) {
+			std::unique_lock<std::mutex> lk(wait_for_data_until(deadline));
+			if (!lk.owns_lock())
+				return false;
+			value = std::move(*pop_front());
+			return true;
+		}
+
+		template<typename Clock, typename Duration>
+		std::shared_ptr<T> wait_and_pop_until(std::chrono::time_point<Clock, Duration> const& deadline) {
+			std::unique_lock<std::mutex> lk(wait_for_data_until(deadline));
+			if (!lk.owns_lock())
+				return std::shared_ptr<T>();
+			return pop_front();
+		}
+
+		template<typename Rep, typename Period>
+		bool wait_and_pop_for(T& value, std::chrono::duration<Rep, Period> const& timeout) {
+			return wait_and_pop_until(value, std::chrono::steady_clock::now() + timeout);
+		}
+
+		template<typename Rep, typename Period>
+		std::shared_ptr<T> wait_and_pop_for(std::chrono::duration<Rep, Period> const& timeout) {
+			return wait_and_pop_until(std::chrono::steady_clock::now() + timeout);
 		}
 
 		bool try_pop(T& value)
@@ -44,22 +246,57 @@ class ThreadSafeQueue
 			std::lock_guard<std::mutex> lk(mut);
 			if (data_queue.empty())
 				return false;
-			value = data_queue.front();
-			data.queue.pop();
+			value = std::move(*pop_front());
 			return true;
 		}
 
 		std::shared_ptr<T> try_pop()
 		{
 			std::lock_guard<std::mutex> lk(mut);
-			std::shared_ptr<T> res(std::make_shared<T>(data_queue.front()));
-			data_queue.pop();
-			return res;
+			if (data_queue.empty())
+				return std::shared_ptr<T>();
+			return pop_front();
+		}
+
+		/*
+			Batch pops: move up to max_n items into `out`
+			under a single critical section and return how
+			many were written.
+
+			pop_bulk never blocks. wait_and_pop_bulk waits up
+			to `timeout` for the first item, then drains
+			whatever is available; 0 means it timed out.
+		*/
+		template<typename OutputIt>
+		std::size_t pop_bulk(OutputIt out, std::size_t max_n)
+		{
+			std::lock_guard<std::mutex> lk(mut);
+			return drain(out, max_n);
+		}
+
+		template<typename OutputIt, typename Rep, typename Period>
+		std::size_t wait_and_pop_bulk(OutputIt out, std::size_t max_n,
+				std::chrono::duration<Rep, Period> const& timeout)
+		{
+			std::unique_lock<std::mutex> lk(wait_for_data_until(std::chrono::steady_clock::now() + timeout));
+			if (!lk.owns_lock())
+				return 0;
+			std::size_t n = drain(out, max_n);
+			// We may have left items behind for other
+			// consumers that were woken alongside us.
+			if (!data_queue.empty() && waiting_consumers > 0)
+				data_cond.notify_one();
+			return n;
 		}
 
 		bool empty() const  {
 			std::lock_guard<std::mutex> lk(mut);
 			return data_queue.empty();
 		}
+
+		// Only available with Telemetry = QueueTelemetry.
+		QueueStats snapshot() const {
+			return telemetry.snapshot();
+		}
 			
-}
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <thread>
+
+/*
+	Wait policies decide what a consumer does before it
+	falls back to sleeping on the queue's condition
+	variable. A futex sleep/wake round trip costs a few
+	microseconds; spinning for a little while first can
+	catch the next item without ever leaving user space,
+	at the price of burning CPU while we wait.
+
+	Each policy exposes
+
+		template<typename Ready>
+		static bool spin(Ready ready);
+
+	which returns true as soon as ready() does, or false
+	once the policy gives up and the caller should block.
+	ready() must be safe to call without the queue lock.
+*/
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
+// Go straight to the condition variable (the classic behaviour).
+struct BlockingWait
+{
+	template<typename Ready>
+	static bool spin(Ready) { return false; }
+};
+
+// Busy-poll with a pause hint, then block.
+template<int Spins = 1000>
+struct SpinThenBlock
+{
+	template<typename Ready>
+	static bool spin(Ready ready)
+	{
+		for (int i = 0; i < Spins; ++i) {
+			if (ready())
+				return true;
+			cpu_relax();
+		}
+		return false;
+	}
+};
+
+// Give the core away between polls, then block.
+template<int Yields = 16>
+struct YieldThenBlock
+{
+	template<typename Ready>
+	static bool spin(Ready ready)
+	{
+		for (int i = 0; i < Yields; ++i) {
+			if (ready())
+				return true;
+			std::this_thread::yield();
+		}
+		return false;
+	}
+};
@@ -0,0 +1,67 @@
+/*
+	NodePool lifetime check.
+
+	A queue with static storage duration, and a shared_ptr
+	popped from one, are destroyed after main's
+	thread_locals, NodePool's per-thread cache included.
+	Their nodes must then go back to the shared list
+	instead of into the destroyed cache. Best run under
+	the sanitizers; exits non-zero on a wrong result.
+
+	Build:
+		g++ -std=c++17 -O1 -g -fsanitize=address,undefined -pthread -I../include static_lifetime.cc -o static_lifetime
+*/
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ThreadSafeQueue.hpp"
+
+namespace {
+
+ThreadSafeQueue<std::string> backlog;
+std::shared_ptr<std::string> last_popped;
+
+// Allocates and frees through the pool once main's
+// thread_locals are already gone.
+struct late_user
+{
+	~late_user()
+	{
+		ThreadSafeQueue<std::string> q;
+		for (int i = 0; i < 100; ++i)
+			q.push("late item " + std::to_string(i));
+		std::string s;
+		while (q.try_pop(s))
+			;
+		if (!q.empty())
+			std::abort();
+	}
+} late;
+
+}
+
+int main()
+{
+	// A producer thread whose cache is torn down while
+	// its nodes are still in the queue.
+	std::thread producer([]{
+		for (int i = 0; i < 1000; ++i)
+			backlog.push("sighting " + std::to_string(i));
+	});
+	producer.join();
+
+	for (int i = 0; i < 500; ++i)
+		last_popped = backlog.wait_and_pop();
+	if (*last_popped != "sighting 499") {
+		std::cerr << "unexpected value " << *last_popped << "\n";
+		return 1;
+	}
+
+	// The other 500 items, last_popped and late's queue
+	// are all freed during static destruction.
+	std::cout << "ok\n";
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+	Stack benchmark: symmetric push/pop load.
+
+	Every thread runs `--ops` iterations of push(i)
+	followed by pop(), the worst case for a single CAS
+	head. Thread counts double from 1 up to
+	`--max-threads` (default 64). Output is CSV:
+
+		variant,threads,ops,ops_per_sec
+
+	and reports on stderr whether split_ref_count_stack's
+	16-byte head is lock-free on this platform.
+
+	Build (-mcx16 enables cmpxchg16b on x86-64; -latomic
+	provides the fallback when it is not available):
+		g++ -std=c++17 -O2 -mcx16 -pthread -I../include -I../../ThreadSafeQueue/include stack_bench.cc -o stack_bench -latomic
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stack>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LockFreeStack.hpp"
+#include "EliminationBackoffStack.hpp"
+#include "SplitRefCountStack.hpp"
+
+namespace {
+
+// Baseline: std::stack behind one mutex.
+template<typename T>
+class mutex_stack
+{
+	private:
+		std::stack<T> data;
+		std::mutex m;
+
+	public:
+		void push(T new_value)
+		{
+			std::lock_guard<std::mutex> lk(m);
+			data.push(std::move(new_value));
+		}
+
+		std::shared_ptr<T> pop()
+		{
+			std::lock_guard<std::mutex> lk(m);
+			if (data.empty())
+				return std::shared_ptr<T>();
+			std::shared_ptr<T> const res(std::make_shared<T>(std::move(data.top())));
+			data.pop();
+			return res;
+		}
+};
+
+struct options
+{
+	std::size_t ops = 200000;
+	unsigned max_threads = 64;
+	std::string variant;
+};
+
+template<typename Stack>
+double run_one(unsigned threads, std::size_t ops)
+{
+	Stack s;
+	std::atomic<bool> go(false);
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; ++t) {
+		workers.emplace_back([&]{
+			while (!go.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			for (std::size_t i = 0; i < ops; ++i) {
+				s.push(static_cast<long>(i));
+				s.pop();
+			}
+		});
+	}
+	auto const start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (std::thread& w : workers)
+		w.join();
+	double const secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return secs > 0 ? 2.0 * static_cast<double>(ops) * threads / secs : 0.0;
+}
+
+template<typename Stack>
+void sweep(char const* name, options const& opt)
+{
+	if (!opt.variant.empty() && opt.variant != name)
+		return;
+	for (unsigned t = 1; t <= opt.max_threads; t *= 2) {
+		std::cout << name << ',' << t << ',' << 2 * opt.ops * t << ','
+			<< static_cast<unsigned long long>(run_one<Stack>(t, opt.ops)) << '\n';
+	}
+}
+
+bool parse_args(int argc, char** argv, options& opt)
+{
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string const arg = argv[i];
+		std::string const value = argv[i + 1];
+		if (arg == "--ops")
+			opt.ops = std::strtoull(value.c_str(), nullptr, 10);
+		else if (arg == "--max-threads")
+			opt.max_threads = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+		else if (arg == "--variant")
+			opt.variant = value;
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+	}
+	if (argc % 2 == 0) {
+		std::cerr << "missing value for " << argv[argc - 1] << "\n";
+		return false;
+	}
+	return opt.ops > 0 && opt.max_threads > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	options opt;
+	if (!parse_args(argc, argv, opt))
+		return 1;
+
+	std::cout << "variant,threads,ops,ops_per_sec\n";
+	sweep<mutex_stack<long>>("mutex", opt);
+	sweep<lock_free_stack<long>>("hazard_pointer", opt);
+	sweep<elimination_backoff_stack<long>>("elimination", opt);
+	sweep<split_ref_count_stack<long>>("split_ref_count", opt);
+
+	// Whether the double-word CAS is native decides if
+	// split_ref_count is really lock-free on this box.
+	std::cerr << "split_ref_count is_lock_free: "
+		<< (split_ref_count_stack<long>().is_lock_free() ? "yes" : "no") << "\n";
+	return 0;
+}
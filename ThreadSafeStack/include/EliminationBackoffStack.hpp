@@ -0,0 +1,246 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include "HazardPointers.hpp"
+#include "WaitPolicy.hpp"
+
+/*
+	Treiber stack with an elimination array in front.
+
+	A push followed by a pop leaves the stack unchanged,
+	so when a push and a pop collide they can simply
+	hand the value over and never touch `head`.
+
+	Each operation first tries one CAS on head. If that
+	fails (another thread won the race) it backs off into
+	the elimination array instead of retrying at once:
+		- a pusher parks its node in a random slot and
+		  waits briefly for a popper to take it,
+		- a popper looks at a random slot and, if a node
+		  is waiting there, claims it with a CAS.
+	If nothing happens, both go back to the CAS on head.
+
+	The array adapts to the load: each thread widens it
+	after a run of failed head CASes, and a pusher that
+	times out with no partner narrows it. Light load
+	keeps the array at one slot, where partners find
+	each other quickly; heavy load spreads them out so
+	the slots themselves don't become the new hot spot.
+*/
+template<typename T>
+class elimination_backoff_stack
+{
+	private:
+		static constexpr std::size_t cache_line = 64;
+		static constexpr unsigned max_width = 32;
+		static constexpr int exchange_spins = 128;
+		static constexpr unsigned grow_after_failures = 4;
+
+		struct node
+		{
+			std::shared_ptr<T> data;
+			node* next;
+
+			explicit node(T data_) : data(std::make_shared<T>(std::move(data_))), next(nullptr) {}
+		};
+
+		struct alignas(cache_line) slot
+		{
+			std::atomic<node*> offer{nullptr};
+		};
+
+		std::atomic<node*> head;
+		alignas(cache_line) std::atomic<unsigned> width;
+		slot slots[max_width];
+
+		// Marks a slot whose offer has been claimed; never dereferenced.
+		static node* taken()
+		{
+			alignas(node) static unsigned char marker;
+			return reinterpret_cast<node*>(&marker);
+		}
+
+		static std::uint64_t next_random()
+		{
+			static thread_local std::uint64_t state =
+				std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			return state;
+		}
+
+		slot& random_slot()
+		{
+			return slots[next_random() % width.load(std::memory_order_relaxed)];
+		}
+
+		void on_cas_failure()
+		{
+			static thread_local unsigned failures = 0;
+			if (++failures < grow_after_failures)
+				return;
+			failures = 0;
+			unsigned w = width.load(std::memory_order_relaxed);
+			if (w < max_width)
+				width.compare_exchange_strong(w, w + 1, std::memory_order_relaxed);
+		}
+
+		void on_exchange_timeout()
+		{
+			unsigned w = width.load(std::memory_order_relaxed);
+			if (w > 1)
+				width.compare_exchange_strong(w, w - 1, std::memory_order_relaxed);
+		}
+
+		bool try_push(node* n)
+		{
+			n->next = head.load(std::memory_order_relaxed);
+			return head.compare_exchange_strong(n->next, n,
+				std::memory_order_release, std::memory_order_relaxed);
+		}
+
+		// Returns false if the CAS lost a race; otherwise
+		// `out` holds the popped node (nullptr if empty).
+		bool try_pop(node*& out)
+		{
+			std::atomic<void*>& hp = get_hazard_pointer_for_current_thread();
+			node* old_head = head.load();
+			node* temp;
+			do {
+				temp = old_head;
+				hp.store(old_head);
+				old_head = head.load();
+			} while (old_head != temp);
+			bool const done = !old_head || head.compare_exchange_strong(old_head, old_head->next);
+			hp.store(nullptr);
+			out = done ? old_head : nullptr;
+			return done;
+		}
+
+		bool exchange_push(node* n)
+		{
+			slot& s = random_slot();
+			node* expected = nullptr;
+			if (!s.offer.compare_exchange_strong(expected, n, std::memory_order_release, std::memory_order_relaxed))
+				return false;
+			for (int i = 0; i < exchange_spins; ++i) {
+				if (s.offer.load(std::memory_order_acquire) == taken()) {
+					s.offer.store(nullptr, std::memory_order_release);
+					return true;
+				}
+				cpu_relax();
+			}
+			expected = n;
+			if (s.offer.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+				on_exchange_timeout();
+				return false;
+			}
+			// A popper claimed it while we were withdrawing.
+			s.offer.store(nullptr, std::memory_order_release);
+			return true;
+		}
+
+		node* exchange_pop()
+		{
+			slot& s = random_slot();
+			node* offer = s.offer.load(std::memory_order_acquire);
+			if (offer && offer != taken() &&
+					s.offer.compare_exchange_strong(offer, taken(), std::memory_order_acq_rel))
+				return offer;
+			return nullptr;
+		}
+
+		// Nodes that came through the array were never on the
+		// stack, so nobody else can see them: delete directly.
+		node* pop_node(bool& from_exchange)
+		{
+			for (;;) {
+				node* n;
+				if (try_pop(n)) {
+					from_exchange = false;
+					return n;
+				}
+				on_cas_failure();
+				if ((n = exchange_pop())) {
+					from_exchange = true;
+					return n;
+				}
+			}
+		}
+
+		void release(node* n, bool from_exchange)
+		{
+			if (from_exchange)
+				delete n;
+			else
+				reclaim_later(n);
+		}
+
+	public:
+		elimination_backoff_stack() : head(nullptr), width(1) {}
+		elimination_backoff_stack(elimination_backoff_stack const&) = delete;
+		elimination_backoff_stack& operator=(elimination_backoff_stack const&) = delete;
+
+		~elimination_backoff_stack()
+		{
+			node* n = head.load();
+			while (n) {
+				node* next = n->next;
+				delete n;
+				n = next;
+			}
+		}
+
+		void push(T new_value)
+		{
+			node* const new_node = new node(std::move(new_value));
+			for (;;) {
+				if (try_push(new_node))
+					return;
+				on_cas_failure();
+				if (exchange_push(new_node))
+					return;
+			}
+		}
+
+		std::shared_ptr<T> pop()
+		{
+			bool from_exchange;
+			node* n = pop_node(from_exchange);
+			std::shared_ptr<T> res;
+			if (n) {
+				res.swap(n->data);
+				release(n, from_exchange);
+			}
+			return res;
+		}
+
+		std::optional<T> pop_value()
+		{
+			bool from_exchange;
+			node* n = pop_node(from_exchange);
+			if (!n)
+				return std::nullopt;
+			std::optional<T> res(std::move(*n->data));
+			release(n, from_exchange);
+			return res;
+		}
+
+		// Current number of active elimination slots.
+		unsigned elimination_width() const
+		{
+			return width.load(std::memory_order_relaxed);
+		}
+
+		// Only a snapshot.
+		bool empty() const
+		{
+			return head.load() == nullptr;
+		}
+};
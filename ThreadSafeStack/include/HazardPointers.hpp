@@ -0,0 +1,177 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/*
+	Hazard pointers.
+
+	Before a thread dereferences a node that another
+	thread might free, it publishes the node's address
+	in its hazard pointer slot. A thread that removes a
+	node does not delete it straight away; it "retires"
+	it onto a thread-local list. Once that list is long
+	enough it is scanned: nodes that no thread has
+	published are deleted, the rest are kept for later.
+
+	This gives lock-free structures safe memory
+	reclamation with no ABA problem: a node's address
+	cannot be reused while anyone still holds a hazard
+	pointer to it.
+
+	Each thread owns one slot (enough for a stack) for
+	as long as it lives. Nodes still retired when a
+	thread exits are handed over to a global orphan list
+	that the next scan adopts.
+*/
+
+constexpr std::size_t max_hazard_pointers = 128;
+
+struct hazard_pointer
+{
+	std::atomic<std::thread::id> id;
+	std::atomic<void*> pointer;
+};
+
+inline hazard_pointer hazard_pointers[max_hazard_pointers];
+
+class hp_owner
+{
+	private:
+		hazard_pointer* hp;
+
+	public:
+		hp_owner() : hp(nullptr)
+		{
+			for (std::size_t i = 0; i < max_hazard_pointers; ++i) {
+				std::thread::id old_id;
+				if (hazard_pointers[i].id.compare_exchange_strong(old_id, std::this_thread::get_id())) {
+					hp = &hazard_pointers[i];
+					break;
+				}
+			}
+			if (!hp)
+				throw std::runtime_error("No hazard pointers available");
+		}
+
+		hp_owner(hp_owner const&) = delete;
+		hp_owner& operator=(hp_owner const&) = delete;
+
+		~hp_owner()
+		{
+			hp->pointer.store(nullptr);
+			hp->id.store(std::thread::id());
+		}
+
+		std::atomic<void*>& get_pointer()
+		{
+			return hp->pointer;
+		}
+};
+
+inline std::atomic<void*>& get_hazard_pointer_for_current_thread()
+{
+	thread_local static hp_owner hazard;
+	return hazard.get_pointer();
+}
+
+struct retired_node
+{
+	void* pointer;
+	void (*deleter)(void*);
+};
+
+class retire_list
+{
+	private:
+		// Scan once we have a couple of candidates per slot,
+		// so each scan frees at least half the list.
+		static constexpr std::size_t scan_threshold = 2 * max_hazard_pointers;
+
+		static std::mutex& orphan_mutex()
+		{
+			static std::mutex m;
+			return m;
+		}
+
+		static std::vector<retired_node>& orphans()
+		{
+			static std::vector<retired_node> nodes;
+			return nodes;
+		}
+
+		std::vector<retired_node> nodes;
+
+		void adopt_orphans()
+		{
+			std::lock_guard<std::mutex> lk(orphan_mutex());
+			nodes.insert(nodes.end(), orphans().begin(), orphans().end());
+			orphans().clear();
+		}
+
+	public:
+		retire_list() { nodes.reserve(scan_threshold); }
+
+		~retire_list()
+		{
+			scan();
+			if (!nodes.empty()) {
+				std::lock_guard<std::mutex> lk(orphan_mutex());
+				orphans().insert(orphans().end(), nodes.begin(), nodes.end());
+			}
+		}
+
+		void add(retired_node n)
+		{
+			nodes.push_back(n);
+			if (nodes.size() >= scan_threshold)
+				scan();
+		}
+
+		void scan()
+		{
+			adopt_orphans();
+			std::vector<void*> hazards;
+			hazards.reserve(max_hazard_pointers);
+			for (std::size_t i = 0; i < max_hazard_pointers; ++i) {
+				if (void* p = hazard_pointers[i].pointer.load())
+					hazards.push_back(p);
+			}
+			std::sort(hazards.begin(), hazards.end());
+
+			auto keep = std::partition(nodes.begin(), nodes.end(), [&](retired_node const& n) {
+				return std::binary_search(hazards.begin(), hazards.end(), n.pointer);
+			});
+			for (auto it = keep; it != nodes.end(); ++it)
+				it->deleter(it->pointer);
+			nodes.erase(keep, nodes.end());
+		}
+};
+
+inline retire_list& retire_list_for_current_thread()
+{
+	thread_local static retire_list list;
+	return list;
+}
+
+template<typename T>
+void do_delete(void* p)
+{
+	delete static_cast<T*>(p);
+}
+
+template<typename T>
+void reclaim_later(T* p)
+{
+	retire_list_for_current_thread().add(retired_node{p, &do_delete<T>});
+}
+
+// Free everything no thread is protecting right now.
+inline void delete_nodes_with_no_hazards()
+{
+	retire_list_for_current_thread().scan();
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+#include "HazardPointers.hpp"
+
+/*
+	Treiber stack: a singly linked list whose head is
+	swapped with compare_exchange.
+
+	push links the new node in front of the current head
+	and CASes it in. pop reads the head, protects it with
+	the thread's hazard pointer, re-checks that it is
+	still the head (otherwise it may already be freed),
+	and then CASes head to head->next. The popped node is
+	retired rather than deleted, since other poppers may
+	still be reading its `next`.
+
+	Values are stored behind a shared_ptr allocated at
+	push time, so pop never allocates and never throws
+	after the node has been unlinked.
+*/
+template<typename T>
+class lock_free_stack
+{
+	private:
+		struct node
+		{
+			std::shared_ptr<T> data;
+			node* next;
+
+			explicit node(T data_) : data(std::make_shared<T>(std::move(data_))), next(nullptr) {}
+		};
+
+		std::atomic<node*> head;
+
+		node* pop_node()
+		{
+			std::atomic<void*>& hp = get_hazard_pointer_for_current_thread();
+			node* old_head = head.load();
+			do {
+				node* temp;
+				do {
+					temp = old_head;
+					hp.store(old_head);
+					old_head = head.load();
+				} while (old_head != temp);
+			} while (old_head &&
+				!head.compare_exchange_strong(old_head, old_head->next));
+			hp.store(nullptr);
+			return old_head;
+		}
+
+	public:
+		lock_free_stack() : head(nullptr) {}
+		lock_free_stack(lock_free_stack const&) = delete;
+		lock_free_stack& operator=(lock_free_stack const&) = delete;
+
+		~lock_free_stack()
+		{
+			node* n = head.load();
+			while (n) {
+				node* next = n->next;
+				delete n;
+				n = next;
+			}
+		}
+
+		void push(T new_value)
+		{
+			node* const new_node = new node(std::move(new_value));
+			new_node->next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(new_node->next, new_node,
+					std::memory_order_release, std::memory_order_relaxed))
+				;
+		}
+
+		std::shared_ptr<T> pop()
+		{
+			node* old_head = pop_node();
+			std::shared_ptr<T> res;
+			if (old_head) {
+				res.swap(old_head->data);
+				reclaim_later(old_head);
+			}
+			return res;
+		}
+
+		std::optional<T> pop_value()
+		{
+			node* old_head = pop_node();
+			if (!old_head)
+				return std::nullopt;
+			std::optional<T> res(std::move(*old_head->data));
+			reclaim_later(old_head);
+			return res;
+		}
+
+		// Only a snapshot.
+		bool empty() const
+		{
+			return head.load() == nullptr;
+		}
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+/*
+	Lock-free stack with split reference counts.
+
+	Instead of hazard pointers, every node carries two
+	counters:
+		- external_count lives next to the pointer in
+		  `head` (a 16-byte counted_node_ptr) and is bumped
+		  by every thread that reads head, *before* it
+		  dereferences the node;
+		- internal_count lives in the node and is
+		  decremented by every thread that is done with it.
+
+	When a node is unlinked, the winner folds the external
+	count into the internal one. Whoever brings the sum to
+	zero deletes the node, so it is freed exactly when the
+	last reader has let go of it.
+
+	Memory orders:
+		- push publishes the node with a release CAS.
+		- increase_head_count uses acquire so the node's
+		  contents are visible before we read them.
+		- the unlinking CAS can be relaxed: the acquire in
+		  increase_head_count already synchronised with
+		  the push.
+		- the fetch_add that may drop the last reference
+		  is release, and the thread that deletes the node
+		  after a relaxed decrement first does an acquire
+		  load, so all other threads' reads of the node
+		  happen-before the delete.
+
+	The 16-byte atomic is lock-free only if the platform
+	has a double-width CAS (cmpxchg16b on x86-64, built
+	with -mcx16; caspal on AArch64). Check is_lock_free();
+	otherwise libatomic falls back to a lock, which is
+	still correct but no longer lock-free.
+*/
+template<typename T>
+class split_ref_count_stack
+{
+	private:
+		struct node;
+
+		// intptr_t rather than int so the struct has no
+		// padding bytes for compare_exchange to trip over.
+		struct counted_node_ptr
+		{
+			std::intptr_t external_count;
+			node* ptr;
+		};
+
+		struct node
+		{
+			std::shared_ptr<T> data;
+			std::atomic<std::intptr_t> internal_count;
+			counted_node_ptr next;
+
+			explicit node(T data_)
+				: data(std::make_shared<T>(std::move(data_))), internal_count(0), next{0, nullptr}
+			{}
+		};
+
+		std::atomic<counted_node_ptr> head;
+
+		void increase_head_count(counted_node_ptr& old_counter)
+		{
+			counted_node_ptr new_counter;
+			do {
+				new_counter = old_counter;
+				++new_counter.external_count;
+			} while (!head.compare_exchange_strong(old_counter, new_counter,
+					std::memory_order_acquire, std::memory_order_relaxed));
+			old_counter.external_count = new_counter.external_count;
+		}
+
+		std::shared_ptr<T> pop_data()
+		{
+			counted_node_ptr old_head = head.load(std::memory_order_relaxed);
+			for (;;) {
+				increase_head_count(old_head);
+				node* const ptr = old_head.ptr;
+				if (!ptr)
+					return std::shared_ptr<T>();
+				if (head.compare_exchange_strong(old_head, ptr->next, std::memory_order_relaxed)) {
+					std::shared_ptr<T> res;
+					res.swap(ptr->data);
+					// -1 for the list's own reference, -1 for ours.
+					std::intptr_t const count_increase = old_head.external_count - 2;
+					if (ptr->internal_count.fetch_add(count_increase, std::memory_order_release) == -count_increase)
+						delete ptr;
+					return res;
+				} else if (ptr->internal_count.fetch_add(-1, std::memory_order_relaxed) == 1) {
+					ptr->internal_count.load(std::memory_order_acquire);
+					delete ptr;
+				}
+			}
+		}
+
+	public:
+		split_ref_count_stack() : head(counted_node_ptr{0, nullptr}) {}
+		split_ref_count_stack(split_ref_count_stack const&) = delete;
+		split_ref_count_stack& operator=(split_ref_count_stack const&) = delete;
+
+		~split_ref_count_stack()
+		{
+			while (pop_data())
+				;
+		}
+
+		// True if head's 16-byte atomic is implemented
+		// without a lock on this platform/build.
+		bool is_lock_free() const
+		{
+			return head.is_lock_free();
+		}
+
+		void push(T new_value)
+		{
+			counted_node_ptr new_node;
+			new_node.ptr = new node(std::move(new_value));
+			new_node.external_count = 1;
+			new_node.ptr->next = head.load(std::memory_order_relaxed);
+			while (!head.compare_exchange_weak(new_node.ptr->next, new_node,
+					std::memory_order_release, std::memory_order_relaxed))
+				;
+		}
+
+		std::shared_ptr<T> pop()
+		{
+			return pop_data();
+		}
+
+		std::optional<T> pop_value()
+		{
+			std::shared_ptr<T> res = pop_data();
+			if (!res)
+				return std::nullopt;
+			return std::optional<T>(std::move(*res));
+		}
+
+		// Only a snapshot.
+		bool empty() const
+		{
+			return head.load(std::memory_order_relaxed).ptr == nullptr;
+		}
+};